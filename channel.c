@@ -30,19 +30,20 @@ double std_dev;		/* Noise standard deviation for AWGN */
 double lwidth;		/* Width of noise distribution for AWLN */
 
 
-/* PARSE A COMMAND-LINE SPECIFICATION OF A CHANNEL.  Takes a pointer to an
-   argument list and an argument count; returns the number of arguments that 
-   make up a channel specification at this point in the command line.  Returns
-   zero if the argument list does not start with a channel specification.
-   Returns -1 if there seems to be a channel specification here, but it's 
-   invalid.
-
-   Sets the variables declared in channel.h to the type and parameters of
-   the channel.
+/* PARSE A COMMAND-LINE SPECIFICATION OF A CHANNEL.  Takes a pointer to a
+   channel specification to set, a pointer to an argument list, and an
+   argument count; returns the number of arguments that make up a channel 
+   specification at this point in the command line.  Returns zero if the 
+   argument list does not start with a channel specification.  Returns -1 
+   if there seems to be a channel specification here, but it's invalid.
+
+   The channel_parse procedure does the same, but sets the variables 
+   declared in channel.h to the type and parameters of the channel.
  */
 
-int channel_parse
-( char **argv,		/* Pointer to argument list */
+int channel_parse_spec
+( channel_spec *ch,	/* Channel specification to set */
+  char **argv,		/* Pointer to argument list */
   int argc		/* Number of arguments in list */
 )
 { 
@@ -52,9 +53,9 @@ int channel_parse
 
   if (strcmp(argv[0],"bsc")==0  || strcmp(argv[0],"BSC")==0)
   { 
-    channel = BSC;
-    if (argc<2 || sscanf(argv[1],"%lf%c",&error_prob,&junk)!=1 
-     || error_prob<=0 || error_prob>=1)
+    ch->type = BSC;
+    if (argc<2 || sscanf(argv[1],"%lf%c",&ch->error_prob,&junk)!=1 
+     || ch->error_prob<=0 || ch->error_prob>=1)
     { return -1;
     }
     else
@@ -63,9 +64,9 @@ int channel_parse
   }
   else if (strcmp(argv[0],"awgn")==0 || strcmp(argv[0],"AWGN")==0)
   { 
-    channel = AWGN;
-    if (argc<2 || sscanf(argv[1],"%lf%c",&std_dev,&junk)!=1 
-     || std_dev<=0)
+    ch->type = AWGN;
+    if (argc<2 || sscanf(argv[1],"%lf%c",&ch->std_dev,&junk)!=1 
+     || ch->std_dev<=0)
     { return -1;
     }
     else
@@ -74,9 +75,9 @@ int channel_parse
   }
   else if (strcmp(argv[0],"awln")==0 || strcmp(argv[0],"AWLN")==0)
   {
-    channel = AWLN;
-    if (argc<2 || sscanf(argv[1],"%lf%c",&lwidth,&junk)!=1 
-     || lwidth<=0)
+    ch->type = AWLN;
+    if (argc<2 || sscanf(argv[1],"%lf%c",&ch->lwidth,&junk)!=1 
+     || ch->lwidth<=0)
     { return -1;
     }
     else
@@ -89,6 +90,70 @@ int channel_parse
   }
 }
 
+int channel_parse
+( char **argv,		/* Pointer to argument list */
+  int argc		/* Number of arguments in list */
+)
+{ 
+  channel_spec ch;
+  int n;
+
+  n = channel_parse_spec(&ch,argv,argc);
+
+  if (n>0)
+  { channel = ch.type;
+    error_prob = ch.error_prob;
+    std_dev = ch.std_dev;
+    lwidth = ch.lwidth;
+  }
+
+  return n;
+}
+
+
+/* FIND LIKELIHOOD RATIOS FOR DATA RECEIVED THROUGH A CHANNEL.  Stores in 
+   lratio the ratio of the probability of each value received given that 
+   a 1 was sent to its probability given that a 0 was sent.  For the BSC, 
+   the values received should be 0 or 1. */
+
+void channel_lratio
+( channel_spec *ch,	/* Channel the data was received through */
+  double *data,		/* Values received */
+  double *lratio,	/* Place to store likelihood ratios */
+  int N			/* Number of values */
+)
+{
+  int i;
+
+  switch (ch->type)
+  { case BSC:
+    { for (i = 0; i<N; i++)
+      { lratio[i] = data[i]==1 ? (1-ch->error_prob) / ch->error_prob
+                               : ch->error_prob / (1-ch->error_prob);
+      }
+      break;
+    }
+    case AWGN:
+    { for (i = 0; i<N; i++)
+      { lratio[i] = exp(2*data[i]/(ch->std_dev*ch->std_dev));
+      }
+      break;
+    }
+    case AWLN:
+    { for (i = 0; i<N; i++)
+      { double e, d1, d0;
+        e = exp(-(data[i]-1)/ch->lwidth);
+        d1 = 1 / ((1+e)*(1+1/e));
+        e = exp(-(data[i]+1)/ch->lwidth);
+        d0 = 1 / ((1+e)*(1+1/e));
+        lratio[i] = d1/d0;
+      }
+      break;
+    }
+    default: abort();
+  }
+}
+
 
 /* PRINT USAGE MESSAGE REGARDING CHANNEL SPECIFICATIONS. */
 
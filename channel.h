@@ -19,6 +19,13 @@
 
 typedef enum { BSC, AWGN, AWLN } channel_type;
 
+typedef struct		/* Channel type and its parameter */
+{ channel_type type;		/* Type of channel */
+  double error_prob;		/* Error probability for BSC */
+  double std_dev;		/* Noise standard deviation for AWGN */
+  double lwidth;		/* Width of noise distribution for AWLN */
+} channel_spec;
+
 extern channel_type channel;	/* Type of channel */
 
 extern double error_prob;	/* Error probability for BSC */
@@ -29,4 +36,7 @@ extern double lwidth;		/* Width of noise distributoin for AWLN */
 /* PROCEDURES TO DO WITH CHANNELS. */
 
 int  channel_parse (char **, int);
+int  channel_parse_spec (channel_spec *, char **, int);
 void channel_usage (void);
+
+void channel_lratio (channel_spec *, double *, double *, int);
@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <math.h>
 
+#include "alloc.h"
 #include "mod2sparse.h"
 #include "check.h"
 
@@ -46,6 +47,165 @@ int check
 }
 
 
+/* FIND PARITY OF A WORD. */
+
+#ifdef __GNUC__
+#define parity64(x) __builtin_parityll(x)
+#else
+static int parity64 (uint64_t x)
+{ x ^= x>>32; x ^= x>>16; x ^= x>>8; x ^= x>>4; x ^= x>>2; x ^= x>>1;
+  return x&1;
+}
+#endif
+
+
+/* SET UP PARITY CHECKS IN PACKED FORM.  The matrix is only read, and may be
+   freed or changed afterwards. */
+
+packed_checks *packed_checks_new
+( mod2sparse *H		/* Parity check matrix */
+)
+{
+  packed_checks *p;
+  mod2entry *e;
+  int M, i, j, k, w;
+
+  M = mod2sparse_rows(H);
+
+  p = chk_alloc (1, sizeof *p);
+
+  p->n_rows = M;
+  p->n_cols = mod2sparse_cols(H);
+  p->n_words = packed_words(p->n_cols);
+
+  /* Count the distinct words for each row.  Entries in a row are in order 
+     of increasing column, so bits in the same word are adjacent. */
+
+  p->row_start = chk_alloc (M+1, sizeof *p->row_start);
+
+  k = 0;
+  for (i = 0; i<M; i++)
+  { p->row_start[i] = k;
+    w = -1;
+    for (e = mod2sparse_first_in_row(H,i);
+         !mod2sparse_at_end(e);
+         e = mod2sparse_next_in_row(e))
+    { if ((mod2sparse_col(e)>>6)!=w) 
+      { w = mod2sparse_col(e)>>6;
+        k += 1;
+      }
+    }
+  }
+  p->row_start[M] = k;
+
+  /* Find the words and masks. */
+
+  p->word = chk_alloc (k, sizeof *p->word);
+  p->mask = chk_alloc (k, sizeof *p->mask);
+
+  for (i = 0; i<M; i++)
+  { k = p->row_start[i] - 1;
+    w = -1;
+    for (e = mod2sparse_first_in_row(H,i);
+         !mod2sparse_at_end(e);
+         e = mod2sparse_next_in_row(e))
+    { j = mod2sparse_col(e);
+      if ((j>>6)!=w) 
+      { w = j>>6;
+        k += 1;
+        p->word[k] = w;
+        p->mask[k] = 0;
+      }
+      p->mask[k] |= (uint64_t)1 << (j&63);
+    }
+  }
+
+  return p;
+}
+
+
+/* FREE PARITY CHECKS IN PACKED FORM. */
+
+void packed_checks_free
+( packed_checks *p	/* Parity checks to free */
+)
+{
+  free(p->row_start);
+  free(p->word);
+  free(p->mask);
+  free(p);
+}
+
+
+/* PACK BITS INTO WORDS.  Bits of a decoding stored one per char (as 0 or 1)
+   are packed 64 to a word, low-order bit first, with unused bits in the last
+   word set to zero. */
+
+void pack_bits
+( char *bits,		/* Bits to pack */
+  int N,		/* Number of bits */
+  uint64_t *w		/* Place to store packed_words(N) words */
+)
+{
+  uint64_t x;
+  int q, b, n;
+
+  for (q = 0; q<packed_words(N); q++)
+  { n = N - (q<<6);
+    if (n>64) n = 64;
+    x = 0;
+    for (b = n-1; b>=0; b--)
+    { x = (x<<1) | (bits[(q<<6)+b]&1);
+    }
+    w[q] = x;
+  }
+}
+
+
+/* COMPUTE PARITY CHECKS FOR A PACKED DECODING.  Returns the number of parity
+   checks violated.  The results of all the parity checks are stored in pchk,
+   unless it is null. */
+
+int packed_check
+( packed_checks *p,	/* Parity checks in packed form */
+  uint64_t *w,		/* Decoding, packed by pack_bits */
+  char *pchk		/* Place to store parity checks, or null */
+)
+{
+  uint64_t x;
+  int i, k, b, c;
+
+  c = 0;
+  for (i = 0; i<p->n_rows; i++)
+  { x = 0;
+    for (k = p->row_start[i]; k<p->row_start[i+1]; k++)
+    { x ^= w[p->word[k]] & p->mask[k];
+    }
+    b = parity64(x);
+    if (pchk) pchk[i] = b;
+    c += b;
+  }
+
+  return c;
+}
+
+
+/* COMPUTE PARITY CHECKS USING THE PACKED FORM.  Gives the same results as
+   check, by packing the decoding into the space given (packed_words(N) 
+   words), and then calling packed_check. */
+
+int check_packed
+( packed_checks *p,	/* Parity checks in packed form */
+  char *dblk,		/* Guess for codeword */
+  char *pchk,		/* Place to store parity checks, or null */
+  uint64_t *w		/* Space for the packed decoding */
+)
+{
+  pack_bits (dblk, p->n_cols, w);
+  return packed_check (p, w, pchk);
+}
+
+
 /* COUNT HOW MANY BITS HAVED CHANGED FROM BIT INDICATED BY LIKELIHOOD.  The
    simple decoding based on likelihood ratio is compared to the given decoding.
    A bit for which the likelihood ratio is exactly one counts as half a 
@@ -13,8 +13,40 @@
  * risk.
  */
 
+#include <stdint.h>	/* Has the definition of uint64_t used below */
+
+
+/* PARITY CHECKS IN PACKED FORM.  For checking a decoding packed 64 bits to
+   a word (low-order bit first), each row of the parity check matrix is 
+   stored as a list of words in the packed decoding that it looks at, with 
+   a mask for each giving the bits in that word that are in the check.  The
+   parity of a check is then the parity of the XOR of the masked words. */
+
+typedef struct packed_checks
+{
+  int n_rows;		/* Number of rows (checks) */
+  int n_cols;		/* Number of columns (bits) */
+  int n_words;		/* Number of words in a packed decoding */
+
+  int *row_start;	/* First word of each row, plus total at the end */
+  int *word;		/* Index of each word in the packed decoding */
+  uint64_t *mask;	/* Mask for the bits in each word */
+
+} packed_checks;
+
+#define packed_words(N) (((N)+63) >> 6)  /* Words for a packed decoding */
+
+
+/* PROCEDURES FOR CHECKING. */
+
 int check (mod2sparse *, char *, char *);
 
+packed_checks *packed_checks_new (mod2sparse *);
+void packed_checks_free (packed_checks *);
+void pack_bits (char *, int, uint64_t *);
+int packed_check (packed_checks *, uint64_t *, char *);
+int check_packed (packed_checks *, char *, char *, uint64_t *);
+
 double changed (double *, char *, int);
 
 double expected_parity_errors (mod2sparse *, double *);
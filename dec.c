@@ -20,11 +20,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "alloc.h"
+#include "open.h"
 #include "mod2sparse.h"
 #include "mod2dense.h"
 #include "mod2convert.h"
+#include "tanner.h"
 #include "rand.h"
 #include "rcode.h"
 #include "check.h"
@@ -32,354 +37,4237 @@
 #include "enc.h"
 
 
-/* GLOBAL VARIABLES.  Declared in dec.h. */
+static void layer_setup (ldpc_decoder *);
+static double prp_bit (ldpc_decoder *, double *, char *, double *, int);
+static void kern_setup (ldpc_decoder *);
+static void prp_rows (ldpc_decoder *, int *, int);
+static uint64_t bit_key (int);
+static void prp_cols (ldpc_decoder *, double *, char *, double *, int *, int);
+static double llr_phi (double);
+static void llr_rows (ldpc_decoder *, int *, int);
+static void ms_rows (ldpc_decoder *, int *, int);
+static void enum_basis_setup (ldpc_decoder *);
+static void wbf_space (ldpc_decoder *);
+static int wbf_run (ldpc_decoder *, double *, char *, int);
 
-decoding_method dec_method;	/* Decoding method to use */
 
-int table;	/* Trace option, 2 for a table of decoding details */
-int block_no;	/* Number of current block, from zero */
+/* CREATE A DECODER FOR A CODE.  The decoder returned uses the method given,
+   with other fields set to zero, except that ms_scale is set to one.  The 
+   caller should set the parameters of the method, and then call dec_setup. */
 
-int max_iter;	/* Maximum number of iteratons of decoding to do */
-char *gen_file;	/* Generator file for Enum_block and Enum_bit */
+ldpc_decoder *dec_new
+( ldpc_code *code,		/* Code to decode */
+  decoding_method method	/* Decoding method to use */
+)
+{
+  ldpc_decoder *d;
+
+  d = chk_alloc (1, sizeof *d);
+
+  d->code = code;
+  d->method = method;
+  d->schedule = Flooding;
+  d->ms_scale = 1;
+
+  return d;
+}
+
+
+/* SET UP A DECODER.  Allocates space for the method, and does any other 
+   setup it needs, including output of headers for the detailed trace, if
+   required. */
+
+void dec_setup
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  switch (d->method)
+  { case Prprp: 
+    { prprp_decode_setup(d);
+      break;
+    }
+    case Minsum: 
+    { minsum_decode_setup(d);
+      break;
+    }
+    case Prprp_llr: 
+    { llr_decode_setup(d);
+      break;
+    }
+    case Fixed: 
+    { fixed_decode_setup(d);
+      break;
+    }
+    case Enum_block: case Enum_bit:
+    { if (d->batch_lanes>0)
+      { enum_batch_setup(d);
+      }
+      else
+      { enum_decode_setup(d);
+      }
+      break;
+    }
+    case Trellis_block: case Trellis_bit:
+    { trellis_decode_setup(d);
+      break;
+    }
+    case Dual_bit:
+    { dual_decode_setup(d);
+      break;
+    }
+    case Cascade:
+    { cascade_decode_setup(d);
+      break;
+    }
+    case Gallager_b:
+    { gallager_decode_setup(d);
+      break;
+    }
+    case Wbf:
+    { wbf_decode_setup(d);
+      break;
+    }
+    default: abort();
+  }
+}
+
+
+/* DECODE A BLOCK.  Uses the decoder's method, as set up by dec_setup, with
+   results as described for prprp_decode below.  If dl_end is non-zero, 
+   the Prprp, Minsum, Prprp_llr, and Cascade methods start no iterations 
+   after the time it gives (as found by dec_clock), and set late to 1 if
+   this is why they stopped.  Other methods ignore dl_end. */
+
+unsigned dec_decode
+( ldpc_decoder *d,	/* Decoder to use */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb		/* Place to store bit probabilities */
+)
+{
+  d->late = 0;
+
+  switch (d->method)
+  { case Prprp:
+    { return prprp_decode (d, lratio, dblk, pchk, bprb);
+    }
+    case Minsum: case Prprp_llr:
+    { return minsum_decode (d, lratio, dblk, pchk, bprb);
+    }
+    case Fixed:
+    { return fixed_decode (d, lratio, dblk, pchk, bprb);
+    }
+    case Enum_block: case Enum_bit:
+    { return enum_decode (d, lratio, dblk, bprb, d->method==Enum_block);
+    }
+    case Trellis_block: case Trellis_bit:
+    { return trellis_decode (d, lratio, dblk, bprb, d->method==Trellis_block);
+    }
+    case Dual_bit:
+    { return dual_decode (d, lratio, dblk, bprb);
+    }
+    case Cascade:
+    { return cascade_decode (d, lratio, dblk, pchk, bprb);
+    }
+    case Gallager_b:
+    { return gallager_decode (d, lratio, dblk, pchk, bprb);
+    }
+    case Wbf:
+    { return wbf_decode (d, lratio, dblk, pchk, bprb);
+    }
+    default: abort();
+  }
+}
+
+
+/* DECODE A BATCH OF BLOCKS.  Only possible if batch_lanes was non-zero when
+   the decoder was set up, which is presently allowed only for Enum_block
+   and Enum_bit, and for Gallager_b.  See enum_decode_batch and 
+   gallager_decode_batch below.  The parity checks are not stored for 
+   Enum_block and Enum_bit. */
+
+void dec_decode_batch
+( ldpc_decoder *d,	/* Decoder to use */
+  int nb,		/* Number of blocks to decode */
+  double **lratio,	/* Likelihood ratios for bits, for each block */
+  char **dblk,		/* Places to store decodings */
+  char **pchk,		/* Places to store parity checks */
+  double **bprb,	/* Places to store bit probabilities */
+  unsigned *iters	/* Places to store number of iterations */
+)
+{
+  if (d->batch_lanes==0) abort();
+
+  switch (d->method)
+  { case Enum_block: case Enum_bit:
+    { enum_decode_batch (d, nb, lratio, dblk, bprb, iters, 
+                         d->method==Enum_block);
+      break;
+    }
+    case Gallager_b:
+    { gallager_decode_batch (d, nb, lratio, dblk, pchk, bprb, iters);
+      break;
+    }
+    default: abort();
+  }
+}
+
+
+/* FREE A DECODER.  The space it used is freed, but not its code. */
+
+void dec_free
+( ldpc_decoder *d	/* Decoder to free */
+)
+{
+  free(d->edge_pr);
+  free(d->edge_lr);
+  free(d->prp_post);
+  free(d->layer_start);
+  free(d->layer_row);
+  free(d->layer_disjoint);
+  free(d->bit_mark);
+  free(d->kern_rows);
+  free(d->kern_cols);
+  free(d->res_in);
+  free(d->res_new);
+  free(d->res_sent);
+  free(d->res_key);
+  free(d->res_exact);
+  free(d->res_heap);
+  free(d->res_hpos);
+  free(d->prp_syn);
+  if (d->osd_H)
+  { mod2dense_free(d->osd_H);
+    mod2dense_free(d->osd_DH);
+    mod2dense_free(d->osd_A);
+    mod2dense_free(d->osd_A2);
+    mod2dense_free(d->osd_AI);
+    mod2dense_free(d->osd_B);
+    mod2dense_free(d->osd_G);
+  }
+  free(d->osd_rows);
+  free(d->osd_rows_inv);
+  free(d->osd_cols);
+  free(d->osd_perm);
+  free(d->osd_info);
+  free(d->osd_gcol);
+  free(d->osd_par);
+  free(d->osd_ypar);
+  free(d->osd_pcost);
+  free(d->osd_icost);
+  free(d->osd_flip);
+  free(d->osd_best);
+  free(d->chk_words);
+  free(d->enum_basis);
+  free(d->enum_book);
+  free(d->enum_dll);
+  free(d->dual_rows);
+  free(d->tr_col);
+  free(d->tr_alpha);
+  free(d->tr_beta);
+  free(d->tr_metric);
+  free(d->tr_choice);
+  free(d->bat_bprb);
+  free(d->ms_c2v);
+  free(d->ms_ch);
+  free(d->ms_tot);
+  free(d->ms_new);
+  free(d->ms_v2c);
+  free(d->llr_tab);
+  free(d->llr_ph);
+  free(d->fx_c2v8);
+  free(d->fx_c2v16);
+  free(d->fx_ch);
+  free(d->fx_chd);
+  free(d->fx_tot);
+  free(d->fx_new);
+  free(d->fx_v2c);
+  free(d->gb_v2c);
+  free(d->gb_chk);
+  free(d->gb_y);
+  free(d->gb_x);
+  free(d->gb_ge);
+  free(d->gb_dis);
+  free(d->gb_row);
+  free(d->gb_pos);
+  free(d->wbf_syn);
+  free(d->wbf_mag);
+  free(d->wbf_gain);
+  free(d->wbf_heap);
+  free(d->wbf_hpos);
+  free(d);
+}
+
+
+/* FIND THE CURRENT TIME.  Returns the time in seconds from some arbitrary
+   starting point, using a clock that isn't affected by changes to the 
+   date, for comparing with dl_end. */
+
+double dec_clock (void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC,&t);
+
+  return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+
+/* FIND THE TANNER GRAPH FOR THE DECODER'S CODE.  It is built from H the first
+   time it is needed, and then kept with the code, for use by other decoders
+   for the same code.  The same is done for the packed form of the parity 
+   checks, which is used to decide when to stop, and space is allocated for
+   the packed decoding. */
+
+static void graph_setup 
+( ldpc_decoder *d
+)
+{
+  if (d->code->graph==0)
+  { d->code->graph = tanner_build(d->code->H);
+  }
+  if (d->code->packed==0)
+  { d->code->packed = packed_checks_new(d->code->H);
+  }
+
+  d->graph = d->code->graph;
+  d->chk_words = chk_alloc (packed_words(d->code->N), sizeof *d->chk_words);
+}
+
+
+/* FIND THE LARGEST NUMBER OF BITS IN ANY CHECK. */
+
+static int max_row_degree
+( tanner_graph *G
+)
+{
+  int i, d;
+
+  d = 0;
+  for (i = 0; i<tanner_rows(G); i++)
+  { if (tanner_row_degree(G,i)>d) d = tanner_row_degree(G,i);
+  }
+
+  return d;
+}
+
+
+/* MOVE AN ITEM UP OR DOWN IN A HEAP.  The heap holds n items (numbered 
+   from zero), with the item with largest key at the top, and with hpos 
+   giving the position of each item in the heap.  The item at position p
+   is moved up while its key is greater than its parent's, or down while it
+   is less than that of its larger child. */
+
+static void heap_up
+( int *heap,		/* Items, in heap order */
+  int *hpos,		/* Position of each item in the heap */
+  double *key,		/* Key for each item */
+  int p			/* Position of item to move */
+)
+{
+  int j, q;
+
+  j = heap[p];
+
+  while (p>0)
+  { q = (p-1)/2;
+    if (key[heap[q]]>=key[j]) break;
+    heap[p] = heap[q];
+    hpos[heap[p]] = p;
+    p = q;
+  }
+
+  heap[p] = j;
+  hpos[j] = p;
+}
+
+static void heap_down
+( int *heap,		/* Items, in heap order */
+  int *hpos,		/* Position of each item in the heap */
+  double *key,		/* Key for each item */
+  int n,		/* Number of items in the heap */
+  int p			/* Position of item to move */
+)
+{
+  int j, q;
+
+  j = heap[p];
+
+  for (;;)
+  { q = 2*p+1;
+    if (q>=n) break;
+    if (q+1<n && key[heap[q+1]]>key[heap[q]]) q += 1;
+    if (key[heap[q]]<=key[j]) break;
+    heap[p] = heap[q];
+    hpos[heap[p]] = p;
+    p = q;
+  }
+
+  heap[p] = j;
+  hpos[j] = p;
+}
+
+
+/* OUTPUT A LINE OF THE DETAILED TRACE FOR AN ITERATIVE METHOD.  The header
+   for these lines is printed by the function below. */
+
+static void trace_header (void)
+{
+  printf(
+     "  block  iter  changed  perrs    loglik   Eperrs   Eloglik  entropy\n");
+}
+
+static void trace_iter
+( ldpc_decoder *d,	/* Decoder, whose code and block number are used */
+  int n,		/* Iteration number */
+  int c,		/* Number of parity check errors */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Current decoding */
+  double *bprb		/* Current bit probabilities */
+)
+{
+  int N;
+
+  N = d->code->N;
+
+  printf("%7d %5d %8.1f %6d %+9.2f %8.1f %+9.2f  %7.1f\n",
+   d->block_no, n, changed(lratio,dblk,N), c, loglikelihood(lratio,dblk,N), 
+   expected_parity_errors(d->code->H,bprb), 
+   expected_loglikelihood(lratio,bprb,N), entropy(bprb,N));
+}
+
+
+/* DECODE BY EXHAUSTIVE ENUMERATION.  Decodes by trying all possible source
+   messages (and hence all possible codewords, unless the parity check matrix
+   was redundant).  If the last argument is 1, it sets dblk to the most likely
+   entire block; if this argument is 0, each bit of dblk is set to the most
+   likely value for that bit.  The marginal probabilities of each bit being 1
+   are returned in bitpr.
+
+   The function value returned is the total number of codewords tried (which 
+   will be the same for all blocks).  The return valued is "unsigned" because
+   it might conceivably be as big as 2^31.
+
+   The generator matrix is taken from the decoder's code, for which it must
+   have been read.
+
+   The messages are divided into chunks of consecutive messages, with the 
+   sums of likelihoods needed for the bit probabilities found for each chunk
+   separately, and then added together in order.  The most likely message 
+   is also found for each chunk, with the most likely overall being the first
+   (in order of enumeration) with the largest likelihood.  If enum_threads is
+   greater than one, the chunks are shared among that many threads.  Since
+   the number of chunks depends only on the number of message bits, the 
+   results are exactly the same for any number of threads.  
+
+   If enum_gray is set, messages are tried in Gray code order, so that each
+   differs from the one before in only one bit, and its codeword can be found
+   by XORing the codeword for that bit with the previous codeword, using
+   codewords for each message bit that are found (in packed form) at setup.
+   The likelihood is then updated for only the bits of the codeword that 
+   changed.  The results are the same as when messages are tried in numerical
+   order, except for round-off error, and except that ties may be broken 
+   differently.
+
+   The number of message bits should not be greater than 31 for this procedure.
+   The setup procedure immediately below checks this, finds the codewords for
+   each message bit if enum_gray is set, and outputs headers for the detailed
+   trace file, if required.
+ */
+
+#define Enum_chunk_bits 16	/* Chunks have at least 2^16 messages... */
+#define Enum_max_chunks 1024	/* ... but there are no more than 1024 chunks */
+
+void enum_decode_setup
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  ldpc_code *code;
+
+  code = d->code;
+
+  if (code->type==0 || (code->type!='s' && code->G==0))
+  { fprintf(stderr,
+      "A generator matrix is needed for decoding by enumeration\n");
+    exit(1);
+  }
+
+  if (code->N-code->M>31)
+  { fprintf(stderr,
+"Trying to decode messages with %d bits by exhaustive enumeration is absurd!\n",
+      code->N-code->M);
+    exit(1);  
+  }
+
+  if (d->enum_gray)
+  { enum_basis_setup(d);
+  }
+
+  if (d->table==2)
+  { printf("  block   decoding  likelihood\n");
+  }
+}
+
+
+/* DATA FOR ENUMERATING THE MESSAGES FOR A BLOCK.  Shared by all threads,
+   each of which stores results only for the chunks it does.  Also used
+   for enumerating the codewords of the dual code for Dual_bit (see below),
+   in which case K is the number of rows of H. */
+
+typedef struct
+{ ldpc_decoder *d;	/* Decoder being used */
+  int K, N;		/* Number of message bits and of codeword bits */
+  int dual;		/* Enumerating the dual code, for Dual_bit? */
+  int want_bpr;		/* Are bit probabilities needed? */
+  int chunk_bits;	/* Log base 2 of the number of messages in a chunk */
+  int n_chunks;		/* Number of chunks */
+
+  double *lk0, *lk1;	/* Likelihoods for each bit being 0 or 1 */
+  double *llk0, *llk1;	/* Their logs, for Gray code order */
+  double *ldelta;	/* Logs of |lk0-lk1|, for Dual_bit */
+  char *ndelta;		/* Whether lk0-lk1 is negative, for Dual_bit */
+
+  double *c_bpr;	/* Sums of likelihoods of bits being 1, for chunks */
+  double *c_tpr;	/* Sums of likelihoods, for each chunk */
+  double *c_maxlk;	/* Largest likelihood in each chunk */
+  unsigned *c_best;	/* First message with the largest likelihood */
+  double *c_zero;	/* Sums for bits with lk0==lk1, for Dual_bit */
+} enum_job;
+
+
+/* SPACE FOR A THREAD ENUMERATING MESSAGES.  The thread does chunks first,
+   first+step, first+2*step, etc. */
+
+typedef struct
+{ enum_job *job;	/* What is being done */
+  int first, step;	/* Chunks this thread does */
+  char *sblk, *cblk;	/* Message and codeword */
+  mod2dense *u, *v;	/* Space for encoding */
+  uint64_t *cw;		/* Packed codeword, for Gray code order */
+  pthread_t thread;	/* The thread, if not the main one */
+} enum_worker;
+
+static void dual_chunk (enum_worker *, int);
+
+
+/* FIND LOWEST SET BIT IN A WORD.  The word must not be zero. */
+
+#ifdef __GNUC__
+#define lowbit32(x) __builtin_ctz(x)
+#define lowbit64(x) __builtin_ctzll(x)
+#else
+static int lowbit64 (uint64_t x)
+{ int b;
+  for (b = 0; !(x&1); b++) x >>= 1;
+  return b;
+}
+#define lowbit32(x) lowbit64(x)
+#endif
+
+
+/* TRY ALL MESSAGES IN A CHUNK.  For Gray code order, message number t is 
+   t^(t>>1), which differs from message number t-1 in the bit given by the 
+   lowest set bit of t.  The codeword for the first message of the chunk is
+   found from the codewords for its bits, and its log likelihood found from
+   all bits, after which the log likelihood is updated for one bit at a 
+   time.  It is kept as a sum of logs of the likelihoods for the bits, along
+   with a count of bits whose likelihood is zero (for which the log would be
+   minus infinity). */
+
+static void enum_chunk
+( enum_worker *w,	/* Thread doing the chunk, with its space */
+  int c			/* Chunk to do */
+)
+{
+  enum_job *e;
+  ldpc_decoder *d;
+  double *bsum, *llk0, *llk1;
+  double lk, maxlk, tsum, slk;
+  uint64_t *basis, *cw, x;
+  unsigned t, t0, t1, m, best;
+  int K, N, W;
+  int nzero;
+  int i, j, q;
+
+  e = w->job;
+  d = e->d;
+  K = e->K;
+  N = e->N;
+  W = packed_words(N);
+
+  llk0 = e->llk0;
+  llk1 = e->llk1;
+  basis = d->enum_basis;
+  cw = w->cw;
+
+  t0 = (unsigned)c << e->chunk_bits;
+  t1 = t0 + (1u << e->chunk_bits);
+
+  bsum = e->want_bpr ? e->c_bpr + (size_t)c*N : 0;
+  if (bsum)
+  { for (j = 0; j<N; j++) bsum[j] = 0.0;
+  }
+
+  tsum = 0.0;
+  maxlk = 0.0;
+  best = 0;
+
+  m = 0;
+  slk = 0;
+  nzero = 0;
+
+  /* Find the codeword and likelihood for the first message, if using Gray
+     code order. */
+
+  if (d->enum_gray)
+  { m = t0 ^ (t0>>1);
+    for (q = 0; q<W; q++) 
+    { cw[q] = 0;
+    }
+    for (i = 0; i<K; i++)
+    { if ((m>>i)&1)
+      { for (q = 0; q<W; q++) 
+        { cw[q] ^= basis[i*W+q];
+        }
+      }
+    }
+    slk = 0;
+    nzero = 0;
+    for (j = 0; j<N; j++)
+    { x = (cw[j>>6]>>(j&63))&1;
+      if ((x ? llk1[j] : llk0[j])==-HUGE_VAL) nzero += 1;
+      else slk += x ? llk1[j] : llk0[j];
+    }
+  }
+
+  for (t = t0; t<t1; t++)
+  {
+    if (d->enum_gray)
+    {
+      /* Change a message bit, and the codeword bits that depend on it, 
+         updating the log likelihood for the bits that changed. */
+
+      if (t>t0)
+      { i = lowbit32(t);
+        m ^= 1u<<i;
+        for (q = 0; q<W; q++)
+        { x = basis[i*W+q];
+          cw[q] ^= x;
+          while (x!=0)
+          { j = (q<<6) + lowbit64(x);
+            x &= x-1;
+            if ((cw[q]>>(j&63))&1) 
+            { if (llk0[j]==-HUGE_VAL) nzero -= 1; else slk -= llk0[j];
+              if (llk1[j]==-HUGE_VAL) nzero += 1; else slk += llk1[j];
+            }
+            else
+            { if (llk1[j]==-HUGE_VAL) nzero -= 1; else slk -= llk1[j];
+              if (llk0[j]==-HUGE_VAL) nzero += 1; else slk += llk0[j];
+            }
+          }
+        }
+      }
+
+      lk = nzero>0 ? 0 : exp(slk);
+
+      if (bsum)
+      { for (q = 0; q<W; q++)
+        { x = cw[q];
+          while (x!=0)
+          { bsum[(q<<6) + lowbit64(x)] += lk;
+            x &= x-1;
+          }
+        }
+      }
+    }
+
+    else
+    {
+      /* Unpack message into source block, and find full codeword. */
+
+      m = t;
+      for (i = K-1; i>=0; i--)
+      { w->sblk[i] = (m>>i)&1;
+      }
+
+      code_encode (d->code, w->sblk, w->cblk, w->u, w->v);
+
+      /* Compute likelihood for this decoding. */
+
+      lk = 1;
+      for (j = 0; j<N; j++)
+      { lk *= w->cblk[j]==0 ? e->lk0[j] : e->lk1[j];
+      }
+
+      if (bsum)
+      { for (j = 0; j<N; j++) 
+        { if (w->cblk[j]==1) 
+          { bsum[j] += lk;
+          }
+        }
+      }
+    }
+
+    /* Update sum of likelihoods and most likely message. */
+
+    tsum += lk;
+
+    if (t==t0 || lk>maxlk)
+    { best = m;
+      maxlk = lk;
+    }
+
+    /* Output data to trace file. */
+
+    if (d->table==2)
+    { printf("%7d %10x  %10.4e\n",d->block_no,m,lk);
+    }
+  }
+
+  e->c_tpr[c] = tsum;
+  e->c_maxlk[c] = maxlk;
+  e->c_best[c] = best;
+}
+
+
+/* DO THE CHUNKS FOR ONE THREAD. */
+
+static void *enum_work
+( void *arg		/* The thread's enum_worker structure */
+)
+{
+  enum_worker *w;
+  int c;
+
+  w = arg;
+
+  for (c = w->first; c<w->job->n_chunks; c += w->step)
+  { if (w->job->dual) 
+    { dual_chunk(w,c);
+    }
+    else
+    { enum_chunk(w,c);
+    }
+  }
+
+  return 0;
+}
+
+
+/* DIVIDE THE ENUMERATION INTO CHUNKS.  The number of chunks depends only on
+   the number of bits enumerated (K), not on the number of threads. */
+
+static void enum_chunks
+( enum_job *job		/* Job to divide, with K set */
+)
+{
+  int K;
+
+  K = job->K;
+
+  job->chunk_bits = K<Enum_chunk_bits ? K : Enum_chunk_bits;
+  while ((K - job->chunk_bits) > 0 
+          && (1<<(K - job->chunk_bits)) > Enum_max_chunks)
+  { job->chunk_bits += 1;
+  }
+  job->n_chunks = 1 << (K - job->chunk_bits);
+}
+
+
+/* DO ALL THE CHUNKS OF AN ENUMERATION.  Creates the decoder's enum_threads 
+   threads (but no more than the number of chunks), or does the chunks in
+   the main thread if there is only one.  Returns the space for the threads,
+   which should be freed with enum_free_workers, with the number of threads 
+   stored in *nw. */
+
+static enum_worker *enum_run
+( enum_job *job,	/* Job to do */
+  int *nw		/* Place to store number of threads */
+)
+{
+  enum_worker *wk;
+  int K, N, P;
+  int i;
+
+  K = job->K;
+  N = job->N;
+
+  P = job->d->enum_threads>1 ? job->d->enum_threads : 1;
+  if (P>job->n_chunks) P = job->n_chunks;
+
+  wk = chk_alloc (P, sizeof *wk);
+
+  for (i = 0; i<P; i++)
+  { wk[i].job = job;
+    wk[i].first = i;
+    wk[i].step = P;
+    wk[i].sblk = chk_alloc (K>0 ? K : 1, sizeof *wk[i].sblk);
+    wk[i].cblk = chk_alloc (N, sizeof *wk[i].cblk);
+    wk[i].cw = chk_alloc (packed_words(N), sizeof *wk[i].cw);
+    encode_space(job->d->code,&wk[i].u,&wk[i].v);
+  }
+
+  if (P==1)
+  { enum_work(&wk[0]);
+  }
+  else
+  { for (i = 0; i<P; i++)
+    { if (pthread_create(&wk[i].thread,0,enum_work,&wk[i])!=0)
+      { fprintf(stderr,"Can't create thread for decoding\n");
+        exit(1);
+      }
+    }
+    for (i = 0; i<P; i++)
+    { pthread_join(wk[i].thread,0);
+    }
+  }
+
+  *nw = P;
+  return wk;
+}
+
+static void enum_free_workers
+( enum_worker *wk,	/* Space for threads */
+  int P			/* Number of threads */
+)
+{
+  int i;
+
+  for (i = 0; i<P; i++)
+  { free(wk[i].sblk);
+    free(wk[i].cblk);
+    free(wk[i].cw);
+    if (wk[i].u) mod2dense_free(wk[i].u);
+    if (wk[i].v) mod2dense_free(wk[i].v);
+  }
+  free(wk);
+}
+
+
+/* DECODE A BLOCK BY ENUMERATION. */
+
+unsigned enum_decode
+( ldpc_decoder *d,	/* Decoder to use */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk, 		/* Place to stored decoded message */
+  double *bitpr,	/* Place to store marginal bit probabilities */
+  int max_block		/* Maximize probability of whole block being correct? */
+)
+{
+  enum_job job;
+  enum_worker *wk;
+  double *bpr, maxlk, tpr;
+  unsigned best;
+  int K, N, W, P;
+  int i, j, q, c;
+
+  N = d->code->N;
+  K = N - d->code->M;
+  W = packed_words(N);
+
+  if (K>31) abort();
+
+  /* Set up the job, with space for the results for each chunk. */
+
+  job.d = d;
+  job.K = K;
+  job.N = N;
+  job.dual = 0;
+
+  enum_chunks(&job);
+
+  bpr = bitpr;
+  if (bpr==0 && max_block==0)
+  { bpr = chk_alloc (N, sizeof *bpr);
+  }
+  job.want_bpr = bpr!=0;
+
+  job.c_bpr = job.want_bpr ? chk_alloc (job.n_chunks*N, sizeof *job.c_bpr) : 0;
+  job.c_tpr = chk_alloc (job.n_chunks, sizeof *job.c_tpr);
+  job.c_maxlk = chk_alloc (job.n_chunks, sizeof *job.c_maxlk);
+  job.c_best = chk_alloc (job.n_chunks, sizeof *job.c_best);
+
+  /* Pre-compute likelihoods for bits, and their logs. */
+
+  job.lk0 = chk_alloc (N, sizeof *job.lk0);
+  job.lk1 = chk_alloc (N, sizeof *job.lk1);
+  job.llk0 = chk_alloc (N, sizeof *job.llk0);
+  job.llk1 = chk_alloc (N, sizeof *job.llk1);
+
+  for (j = 0; j<N; j++)
+  { job.lk0[j] = 1/(1+lratio[j]);
+    job.lk1[j] = 1 - job.lk0[j];
+    job.llk0[j] = job.lk0[j]==0 ? -HUGE_VAL : log(job.lk0[j]);
+    job.llk1[j] = job.lk1[j]==0 ? -HUGE_VAL : log(job.lk1[j]);
+  }
+
+  /* Do the chunks, using as many threads as wanted. */
+
+  wk = enum_run(&job,&P);
+
+  /* Combine the results for the chunks, in order. */
+
+  best = 0;
+  maxlk = 0.0;
+  tpr = 0.0;
+
+  if (bpr)
+  { for (j = 0; j<N; j++) bpr[j] = 0.0;
+  }
+
+  for (c = 0; c<job.n_chunks; c++)
+  { if (c==0 || job.c_maxlk[c]>maxlk)
+    { best = job.c_best[c];
+      maxlk = job.c_maxlk[c];
+    }
+    if (bpr)
+    { for (j = 0; j<N; j++) bpr[j] += job.c_bpr[(size_t)c*N+j];
+      tpr += job.c_tpr[c];
+    }
+  }
+
+  /* Normalize bit probabilities. */
+
+  if (bpr)
+  { for (j = 0; j<N; j++) bpr[j] /= tpr;
+  }
+
+  /* Find the codeword for the most likely message, if that's the decoding
+     wanted, or decode to maximize bit-by-bit success (with ties decoded to
+     a 1). */
+
+  if (max_block)
+  { if (d->enum_gray)
+    { for (q = 0; q<W; q++) wk[0].cw[q] = 0;
+      for (i = 0; i<K; i++)
+      { if ((best>>i)&1)
+        { for (q = 0; q<W; q++) wk[0].cw[q] ^= d->enum_basis[i*W+q];
+        }
+      }
+      for (j = 0; j<N; j++)
+      { dblk[j] = (wk[0].cw[j>>6]>>(j&63))&1;
+      }
+    }
+    else
+    { for (i = K-1; i>=0; i--)
+      { wk[0].sblk[i] = (best>>i)&1;
+      }
+      code_encode (d->code, wk[0].sblk, dblk, wk[0].u, wk[0].v);
+    }
+  }
+  else
+  { for (j = 0; j<N; j++) 
+    { dblk[j] = bpr[j]>=0.5;
+    }
+  }
+
+  /* Free space. */
+
+  enum_free_workers(wk,P);
+
+  if (bpr!=0 && bpr!=bitpr) free(bpr);
+  free(job.c_bpr);
+  free(job.c_tpr);
+  free(job.c_maxlk);
+  free(job.c_best);
+  free(job.lk0);
+  free(job.lk1);
+  free(job.llk0);
+  free(job.llk1);
+
+  return 1u<<K;
+}
+
+
+/* FIND THE CODEWORDS FOR EACH MESSAGE BIT.  The codeword for the message 
+   with only bit i set is stored in packed form (see check.c) in enum_basis,
+   starting at word i*packed_words(N).  Since encoding is linear, the 
+   codeword for any message is the XOR of the codewords for its bits. */
+
+static void enum_basis_setup
+( ldpc_decoder *d	/* Decoder being set up */
+)
+{
+  mod2dense *u, *v;
+  char *sblk, *cblk;
+  int K, N, W;
+  int i;
+
+  N = d->code->N;
+  K = N - d->code->M;
+  W = packed_words(N);
+
+  sblk = chk_alloc (K, sizeof *sblk);
+  cblk = chk_alloc (N, sizeof *cblk);
+  encode_space(d->code,&u,&v);
+
+  d->enum_basis = chk_alloc (K*W, sizeof *d->enum_basis);
+
+  for (i = 0; i<K; i++)
+  { sblk[i] = 1;
+    code_encode (d->code, sblk, cblk, u, v);
+    pack_bits (cblk, N, d->enum_basis + i*W);
+    sblk[i] = 0;
+  }
+
+  free(sblk);
+  free(cblk);
+  if (u) mod2dense_free(u);
+  if (v) mod2dense_free(v);
+}
+
+
+/* DECODE BIT BY BIT USING THE DUAL CODE.  Finds the same bit probabilities
+   as enum_decode (for Enum_bit), except for round-off error, but by summing
+   over the 2^M codewords of the dual code (the sums of rows of H), which is
+   much faster for high-rate codes, and doesn't need a generator matrix.
+
+   With d_i = Pr(bit i is 0) - Pr(bit i is 1), and w(u) the product of d_i 
+   for the bits, i, that are 1 in dual codeword u, the sum of likelihoods of
+   codewords with bit j being 0 is proportional to p0_j (A_j + B_j), and 
+   the sum for bit j being 1 is proportional to p1_j (A_j - B_j), where A_j 
+   is the sum of w(u) for dual codewords with u_j=0, and B_j is the sum of 
+   w(u)/d_j for dual codewords with u_j=1 (Hartmann and Rudolph, 1976).  The
+   sum of w(u) over all dual codewords, W, and over those with u_j=1, S_j,
+   are accumulated, so that A_j = W - S_j and B_j = S_j/d_j, except that
+   when d_j is zero, B_j is accumulated separately.  If H has redundant
+   rows, each dual codeword is counted several times, which does not affect
+   the result.
+
+   The dual codewords are enumerated in Gray code order, in chunks, which 
+   may be done by several threads, as for enum_decode (using the same
+   procedures).  The sign of w(u) and the sum of logs of |d_i| are updated
+   for only the bits that change from one dual codeword to the next, along
+   with the number of bits with d_i zero.  Sums may cancel, so round-off
+   error can be larger than for enum_decode.
+
+   Each bit is decoded to its most likely value, with ties decoded to a 1.
+   The value returned is the number of dual codewords tried.  The setup 
+   procedure immediately below checks that M is not greater than 31, and 
+   stores the rows of H in packed form. */
+
+void dual_decode_setup
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  mod2entry *e;
+  int M, N, W;
+  int i, j;
+
+  M = d->code->M;
+  N = d->code->N;
+  W = packed_words(N);
+
+  if (M>31)
+  { fprintf(stderr,
+"Trying to decode by enumerating a dual code with %d checks is absurd!\n", M);
+    exit(1);  
+  }
+
+  d->dual_rows = chk_alloc (M*W, sizeof *d->dual_rows);
+
+  for (i = 0; i<M; i++)
+  { for (e = mod2sparse_first_in_row(d->code->H,i);
+         !mod2sparse_at_end(e);
+         e = mod2sparse_next_in_row(e))
+    { j = mod2sparse_col(e);
+      d->dual_rows[i*W+(j>>6)] |= (uint64_t)1 << (j&63);
+    }
+  }
+}
+
+
+/* ADD OR REMOVE A BIT FROM THE DUAL CODEWORD IN DUAL_CHUNK. */
+
+#define dual_flip(j,in) \
+( e->ldelta[j]==-HUGE_VAL ? (nzero += (in) ? 1 : -1) \
+   : (slog += (in) ? e->ldelta[j] : -e->ldelta[j], neg ^= e->ndelta[j]) )
+
+
+/* DO ONE CHUNK OF THE DUAL CODEWORDS.  The sums are stored in c_tpr (W), 
+   c_bpr (S_j), and c_zero (B_j for bits with d_j zero). */
+
+static void dual_chunk
+( enum_worker *w,	/* Thread doing the chunk, with its space */
+  int c			/* Chunk to do */
+)
+{
+  enum_job *e;
+  double *ssum, *zsum;
+  double wt, tsum, slog;
+  uint64_t *rows, *cw, x;
+  unsigned t, t0, t1, g;
+  int K, N, W;
+  int nzero, neg;
+  int i, j, q;
+
+  e = w->job;
+  K = e->K;
+  N = e->N;
+  W = packed_words(N);
+
+  rows = e->d->dual_rows;
+  cw = w->cw;
+
+  t0 = (unsigned)c << e->chunk_bits;
+  t1 = t0 + (1u << e->chunk_bits);
+
+  ssum = e->c_bpr + (size_t)c*N;
+  zsum = e->c_zero + (size_t)c*N;
+  for (j = 0; j<N; j++) 
+  { ssum[j] = 0.0;
+    zsum[j] = 0.0;
+  }
+  tsum = 0.0;
+
+  /* Find the first dual codeword of the chunk, as a sum of rows. */
+
+  g = t0 ^ (t0>>1);
+  for (q = 0; q<W; q++) 
+  { cw[q] = 0;
+  }
+  for (i = 0; i<K; i++)
+  { if ((g>>i)&1)
+    { for (q = 0; q<W; q++) 
+      { cw[q] ^= rows[i*W+q];
+      }
+    }
+  }
+
+  slog = 0;
+  neg = 0;
+  nzero = 0;
+  for (q = 0; q<W; q++)
+  { x = cw[q];
+    while (x!=0)
+    { j = (q<<6) + lowbit64(x);
+      x &= x-1;
+      dual_flip(j,1);
+    }
+  }
+
+  for (t = t0; t<t1; t++)
+  {
+    /* Add a row, updating for the bits that changed. */
+
+    if (t>t0)
+    { i = lowbit32(t);
+      for (q = 0; q<W; q++)
+      { x = rows[i*W+q];
+        cw[q] ^= x;
+        while (x!=0)
+        { j = (q<<6) + lowbit64(x);
+          x &= x-1;
+          dual_flip(j,(cw[q]>>(j&63))&1);
+        }
+      }
+    }
+
+    /* Add to the sums.  Only dual codewords with no bits with d_j zero 
+       contribute to W and S_j, and those with only one such bit to B_j
+       for that bit. */
+
+    if (nzero>1) continue;
+
+    wt = neg ? -exp(slog) : exp(slog);
+
+    if (nzero==0)
+    { tsum += wt;
+      for (q = 0; q<W; q++)
+      { x = cw[q];
+        while (x!=0)
+        { ssum[(q<<6) + lowbit64(x)] += wt;
+          x &= x-1;
+        }
+      }
+    }
+    else
+    { for (q = 0; q<W; q++)
+      { x = cw[q];
+        while (x!=0)
+        { j = (q<<6) + lowbit64(x);
+          x &= x-1;
+          if (e->ldelta[j]==-HUGE_VAL) zsum[j] += wt;
+        }
+      }
+    }
+  }
+
+  e->c_tpr[c] = tsum;
+}
+
+unsigned dual_decode
+( ldpc_decoder *d,	/* Decoder to use */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk, 		/* Place to stored decoded message */
+  double *bprb		/* Place to store marginal bit probabilities */
+)
+{
+  enum_job job;
+  enum_worker *wk;
+  double *S, *Z, tw, a, b, p0, p1, z0, z1, dl, pr;
+  int M, N, P;
+  int j, c;
+
+  M = d->code->M;
+  N = d->code->N;
+
+  if (M>31) abort();
+
+  /* Set up the job, with space for the results for each chunk. */
+
+  job.d = d;
+  job.K = M;
+  job.N = N;
+  job.dual = 1;
+  job.want_bpr = 1;
+
+  enum_chunks(&job);
+
+  job.c_bpr = chk_alloc (job.n_chunks*N, sizeof *job.c_bpr);
+  job.c_zero = chk_alloc (job.n_chunks*N, sizeof *job.c_zero);
+  job.c_tpr = chk_alloc (job.n_chunks, sizeof *job.c_tpr);
+
+  job.ldelta = chk_alloc (N, sizeof *job.ldelta);
+  job.ndelta = chk_alloc (N, sizeof *job.ndelta);
+
+  for (j = 0; j<N; j++)
+  { p0 = 1/(1+lratio[j]);
+    dl = p0 - (1-p0);
+    job.ldelta[j] = dl==0 ? -HUGE_VAL : log(fabs(dl));
+    job.ndelta[j] = dl<0;
+  }
+
+  /* Do the chunks, using as many threads as wanted. */
+
+  wk = enum_run(&job,&P);
+  enum_free_workers(wk,P);
+
+  /* Combine the sums for the chunks, in order. */
+
+  S = chk_alloc (N, sizeof *S);
+  Z = chk_alloc (N, sizeof *Z);
+  tw = 0;
+
+  for (c = 0; c<job.n_chunks; c++)
+  { for (j = 0; j<N; j++) 
+    { S[j] += job.c_bpr[(size_t)c*N+j];
+      Z[j] += job.c_zero[(size_t)c*N+j];
+    }
+    tw += job.c_tpr[c];
+  }
+
+  /* Find the bit probabilities and decoding. */
+
+  for (j = 0; j<N; j++)
+  { p0 = 1/(1+lratio[j]);
+    p1 = 1 - p0;
+    if (job.ldelta[j]==-HUGE_VAL)
+    { a = tw;
+      b = Z[j];
+    }
+    else
+    { dl = p0 - p1;
+      a = tw - S[j];
+      b = S[j] / dl;
+    }
+    z0 = p0 * (a+b);
+    z1 = p1 * (a-b);
+    pr = z1 / (z0+z1);
+    if (bprb) bprb[j] = pr;
+    dblk[j] = pr>=0.5;
+  }
+
+  free(S);
+  free(Z);
+  free(job.c_bpr);
+  free(job.c_zero);
+  free(job.c_tpr);
+  free(job.ldelta);
+  free(job.ndelta);
+
+  return 1u<<M;
+}
+
+
+/* DECODE A BATCH OF BLOCKS BY ENUMERATION.  Decodes up to batch_lanes 
+   blocks at once, with results for each block as for enum_decode, except 
+   for round-off error (and hence perhaps how ties are broken).  The 
+   codewords for all messages are found in packed form at setup (so this is
+   feasible only if there aren't too many message bits), rather than being
+   found again for every block.
+
+   The log likelihood of a codeword for a block is found as the log 
+   likelihood of the zero codeword plus, for each bit that is 1 in the 
+   codeword, the difference in log likelihoods for the bit being 1 versus 0.
+   These differences are stored by bit and lane (ie, block), so that each
+   codeword is fetched once for all the blocks in the batch, and the loops 
+   over lanes can be done with SIMD instructions.  The sums of likelihoods 
+   needed for bit probabilities are accumulated in the same way.  Likelihoods
+   of zero have their logs set to Enum_log_zero, so that the likelihood of a
+   codeword with such a bit underflows to zero.
+
+   The arguments are arrays of pointers to the data for each block, with
+   the number of codewords tried stored in iters.  Only the first nb 
+   pointers in each array are used. */
+
+#define Enum_log_zero -1000.0	/* Log used for a likelihood of zero */
+#define Enum_max_book (1<<27)	/* Largest number of words in the codebook */
+
+void enum_batch_setup
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  uint64_t *book;
+  unsigned m;
+  int K, N, L, W;
+  int q;
+
+  enum_decode_setup(d);
+
+  N = d->code->N;
+  K = N - d->code->M;
+  L = d->batch_lanes;
+  W = packed_words(N);
+
+  if (L<=0 || L%Batch_vec!=0 || L>Batch_max) abort();
+
+  if (K>=31 || ((double)W * (1u<<K)) > Enum_max_book)
+  { fprintf(stderr,
+      "Too many message bits (%d) to decode by enumeration in batches\n", K);
+    exit(1);
+  }
+
+  if (d->enum_basis==0)
+  { enum_basis_setup(d);
+  }
+
+  /* Find the codeword for each message from the codeword for that message
+     without its lowest set bit. */
+
+  book = d->enum_book = chk_alloc ((size_t)W << K, sizeof *d->enum_book);
+
+  for (m = 1; m<(1u<<K); m++)
+  { for (q = 0; q<W; q++)
+    { book[(size_t)m*W+q] = book[(size_t)(m&(m-1))*W+q] 
+                             ^ d->enum_basis[lowbit32(m)*W+q];
+    }
+  }
+
+  d->enum_dll = chk_alloc (N*L, sizeof *d->enum_dll);
+  d->bat_bprb = chk_alloc (N*L, sizeof *d->bat_bprb);
+}
+
+void enum_decode_batch
+( ldpc_decoder *d,	/* Decoder to use */
+  int nb,		/* Number of blocks to decode */
+  double **lratio,	/* Likelihood ratios for bits, for each block */
+  char **dblk,		/* Places to store decodings */
+  double **bprb,	/* Places to store bit probabilities */
+  unsigned *iters,	/* Places to store number of codewords tried */
+  int max_block		/* Maximize probability of whole block being correct? */
+)
+{
+  double base[Batch_max], ll[Batch_max], lk[Batch_max];
+  double maxlk[Batch_max], tpr[Batch_max];
+  unsigned best[Batch_max];
+  double *dll, *bsum, *p, l0, l1, v0, v1;
+  uint64_t *cw, x;
+  unsigned m;
+  int K, N, L, W, U;
+  int j, l, q;
+
+  N = d->code->N;
+  K = N - d->code->M;
+  L = d->batch_lanes;
+  W = packed_words(N);
+
+  if (nb<1 || nb>L) abort();
+
+  dll = d->enum_dll;
+  bsum = d->bat_bprb;
+
+  /* Only the groups of lanes up to the last one in use are computed. */
+
+  U = (nb+Batch_vec-1) / Batch_vec * Batch_vec;
+
+  /* Find the log likelihoods of the zero codeword, and the differences
+     in log likelihoods, with unused lanes given likelihood ratios of one. */
+
+  for (l = 0; l<U; l++)
+  { base[l] = 0;
+    tpr[l] = 0;
+    maxlk[l] = 0;
+    best[l] = 0;
+  }
+
+  for (j = 0; j<N; j++)
+  { for (l = 0; l<U; l++)
+    { l0 = l<nb ? 1/(1+lratio[l][j]) : 0.5;
+      l1 = 1 - l0;
+      v0 = l0==0 ? Enum_log_zero : log(l0);
+      v1 = l1==0 ? Enum_log_zero : log(l1);
+      base[l] += v0;
+      dll[j*L+l] = v1 - v0;
+      bsum[j*L+l] = 0;
+    }
+  }
+
+  /* Try all messages, in numerical order. */
+
+  for (m = 0; m<(1u<<K); m++)
+  { 
+    cw = d->enum_book + (size_t)m*W;
+
+    for (l = 0; l<U; l++) 
+    { ll[l] = base[l];
+    }
+
+    for (q = 0; q<W; q++)
+    { x = cw[q];
+      while (x!=0)
+      { p = dll + ((q<<6) + lowbit64(x)) * L;
+        x &= x-1;
+        for (l = 0; l<U; l++)
+        { ll[l] += p[l];
+        }
+      }
+    }
+
+    for (l = 0; l<U; l++) 
+    { lk[l] = exp(ll[l]);
+      tpr[l] += lk[l];
+    }
+
+    if (max_block)
+    { for (l = 0; l<nb; l++)
+      { if (m==0 || lk[l]>maxlk[l])
+        { best[l] = m;
+          maxlk[l] = lk[l];
+        }
+      }
+    }
+
+    for (q = 0; q<W; q++)
+    { x = cw[q];
+      while (x!=0)
+      { p = bsum + ((q<<6) + lowbit64(x)) * L;
+        x &= x-1;
+        for (l = 0; l<U; l++)
+        { p[l] += lk[l];
+        }
+      }
+    }
+  }
+
+  /* Store the bit probabilities and decodings for each block. */
+
+  for (l = 0; l<nb; l++)
+  { for (j = 0; j<N; j++)
+    { v0 = bsum[j*L+l] / tpr[l];
+      if (bprb) bprb[l][j] = v0;
+      if (max_block)
+      { cw = d->enum_book + (size_t)best[l]*W;
+        dblk[l][j] = (cw[j>>6]>>(j&63))&1;
+      }
+      else
+      { dblk[l][j] = v0>=0.5;
+      }
+    }
+    iters[l] = 1u<<K;
+  }
+}
+
+
+/* DECODE USING THE SYNDROME TRELLIS.  Decodes optimally, as for enum_decode,
+   but using the trellis whose states after bit j are the values of the 
+   parity checks for bits 0 to j-1, so that the paths from state zero at the
+   start to state zero at the end are the codewords.  Each bit has one branch
+   into each state for each value of the bit, so the time needed is 
+   proportional to N times 2^M, which for a high-rate code is much less than
+   for enumerating all 2^(N-M) messages.
+
+   If the last argument is 1, the most likely codeword is found with the
+   Viterbi algorithm (ties being broken in favour of a zero for the later
+   bit), otherwise each bit is set to its most likely value (a 1 if tied).
+   The bit probabilities are found with the forward-backward (BCJR) 
+   algorithm, which is also done for the first case if bprb isn't null.  
+   The forward and backward probabilities are rescaled for each bit to 
+   avoid underflow.
+
+   The value returned is the number of states in the trellis for each bit.
+
+   The number of checks should not be more than 30, and N times 2^M should
+   not be greater than Trellis_max.  The setup procedure immediately below
+   checks this, and finds the columns of H as bit masks. */
+
+#define Trellis_max (1<<26)	/* Largest number of states times bits */
+
+void trellis_decode_setup
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  mod2entry *e;
+  int M, N, S;
+  int j;
+
+  M = d->code->M;
+  N = d->code->N;
+
+  if (M>30 || (double)N * (1<<M) > Trellis_max)
+  { fprintf(stderr,
+      "Trellis decoding with %d checks and %d bits is too costly\n", M, N);
+    exit(1);
+  }
+
+  S = 1<<M;
+
+  d->tr_col = chk_alloc (N, sizeof *d->tr_col);
+  for (j = 0; j<N; j++)
+  { for (e = mod2sparse_first_in_col(d->code->H,j);
+         !mod2sparse_at_end(e);
+         e = mod2sparse_next_in_col(e))
+    { d->tr_col[j] |= 1u << mod2sparse_row(e);
+    }
+  }
+
+  d->tr_alpha = chk_alloc ((size_t)N*S, sizeof *d->tr_alpha);
+  d->tr_beta = chk_alloc (2*S, sizeof *d->tr_beta);
+
+  if (d->method==Trellis_block)
+  { d->tr_metric = chk_alloc (2*S, sizeof *d->tr_metric);
+    d->tr_choice = chk_alloc ((size_t)N*S, sizeof *d->tr_choice);
+  }
+}
+
+unsigned trellis_decode
+( ldpc_decoder *d,	/* Decoder to use */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk, 		/* Place to stored decoded message */
+  double *bprb,		/* Place to store marginal bit probabilities */
+  int max_block		/* Maximize probability of whole block being correct? */
+)
+{
+  double *a, *b, *bn, *v, *vn, *tmp;
+  double p0, p1, l0, l1, s0, s1, t;
+  unsigned *col, h;
+  char *ch;
+  int M, N, S;
+  int j, s;
+
+  M = d->code->M;
+  N = d->code->N;
+  S = 1<<M;
+  col = d->tr_col;
+
+  /* Find the bit probabilities by the forward-backward algorithm. */
+
+  if (!max_block || bprb)
+  { 
+    /* Forward pass, storing the probabilities for the states before each 
+       bit, given the bits before. */
+
+    a = d->tr_alpha;
+    for (s = 0; s<S; s++) a[s] = 0;
+    a[0] = 1;
+
+    for (j = 0; j<N-1; j++)
+    { p0 = 1/(1+lratio[j]);
+      p1 = 1 - p0;
+      h = col[j];
+      t = 0;
+      for (s = 0; s<S; s++)
+      { a[S+s] = a[s]*p0 + a[s^h]*p1;
+        t += a[S+s];
+      }
+      for (s = 0; s<S; s++) a[S+s] /= t;
+      a += S;
+    }
+
+    /* Backward pass, combining the probabilities for the states after each
+       bit, given the bits after, with those from the forward pass. */
+
+    b = d->tr_beta;
+    bn = b + S;
+    for (s = 0; s<S; s++) b[s] = 0;
+    b[0] = 1;
+
+    for (j = N-1; j>=0; j--)
+    { a = d->tr_alpha + (size_t)j*S;
+      p0 = 1/(1+lratio[j]);
+      p1 = 1 - p0;
+      h = col[j];
+      s0 = s1 = 0;
+      for (s = 0; s<S; s++)
+      { s0 += a[s] * b[s];
+        s1 += a[s] * b[s^h];
+      }
+      s0 *= p0;
+      s1 *= p1;
+      if (bprb) bprb[j] = s1 / (s0+s1);
+      if (!max_block) dblk[j] = s1>=s0;
+      t = 0;
+      for (s = 0; s<S; s++)
+      { bn[s] = b[s]*p0 + b[s^h]*p1;
+        t += bn[s];
+      }
+      for (s = 0; s<S; s++) bn[s] /= t;
+      tmp = b; b = bn; bn = tmp;
+    }
+  }
+
+  /* Find the most likely codeword with the Viterbi algorithm. */
+
+  if (max_block)
+  { 
+    v = d->tr_metric;
+    vn = v + S;
+    for (s = 0; s<S; s++) v[s] = -HUGE_VAL;
+    v[0] = 0;
+
+    for (j = 0; j<N; j++)
+    { p0 = 1/(1+lratio[j]);
+      p1 = 1 - p0;
+      l0 = p0==0 ? -HUGE_VAL : log(p0);
+      l1 = p1==0 ? -HUGE_VAL : log(p1);
+      h = col[j];
+      ch = d->tr_choice + (size_t)j*S;
+      for (s = 0; s<S; s++)
+      { s0 = v[s] + l0;
+        s1 = v[s^h] + l1;
+        ch[s] = s1>s0;
+        vn[s] = s1>s0 ? s1 : s0;
+      }
+      tmp = v; v = vn; vn = tmp;
+    }
+
+    s = 0;
+    for (j = N-1; j>=0; j--)
+    { dblk[j] = d->tr_choice[(size_t)j*S+s];
+      if (dblk[j]) s ^= col[j];
+    }
+  }
+
+  return S;
+}
+
+
+/* DECODE USING PROBABILITY PROPAGATION.  Tries to find the most probable 
+   values for the bits of the codeword, given a parity check matrix (H), and
+   likelihood ratios (lratio) for each bit.  If max_iter is positive, up to 
+   that many iterations of probability propagation are done, stopping before 
+   then if the tentative decoding is a valid codeword.  If max_iter is 
+   negative, abs(max_iter) iterations are done, regardless of whether a 
+   codeword was found earlier.
+
+   Returns the number of iterations done (as an "unsigned" for consistency
+   with enum_decode).  Regardless of whether or not a valid codeword was 
+   reached, the bit vector from thresholding the bit-by-bit probabilities is 
+   stored in dblk, and the resulting parity checks are stored in pchk (all 
+   will be zero if the codeword is valid).  The final probabilities for each 
+   bit being a 1 are stored in bprb.
+
+   The parity checks for the tentative decoding are found in full only at
+   the start.  After that, they are updated incrementally, by flipping the
+   checks for a bit whenever its value in the decoding changes, so that
+   deciding whether to stop takes time proportional to the number of changes
+   rather than to the number of 1s in H.
+
+   If schedule is Flooding, each iteration recomputes the likelihood ratios
+   for all checks, and then the probability ratios for all bits.  If it is
+   Layered, the rows are divided into layers, and each iteration goes through
+   the layers in turn, recomputing the likelihood ratios for the checks in 
+   the layer and then immediately updating the probabilities for the bits 
+   in these checks.  This usually reduces the number of iterations needed.
+   If it is Residual, checks are updated one at a time, always choosing the
+   check whose new likelihood ratios differ most from those last sent (see 
+   iterres below), with an iteration being as many check updates as there 
+   are checks.  Propagation stops as soon as the decoding is a codeword, 
+   even in the middle of an iteration, if max_iter is positive.
+
+   If stop_after is non-zero (and max_iter is positive), propagation also 
+   stops when for stop_after iterations in a row the decoding has been the
+   same as that one or two iterations before - ie, it has settled on one
+   decoding that isn't a codeword, or alternates between two - since the
+   decoding is then unlikely ever to succeed.  The field stopped is set 
+   to 1 if this happens, and to 0 otherwise.  Guesses are compared using 
+   a hash, kept up to date as bits are changed, so a match might (very
+   rarely) be a false one.  The number of unsatisfied checks isn't used,
+   since it often rises and stays high for many iterations before a block
+   is decoded.
+
+   If osd is set, and no codeword was found when the iterations stop, the
+   final bit probabilities are used to find a codeword by ordered-statistics
+   decoding (see osd_decode below), which replaces the decoding in dblk.
+   The bit probabilities in bprb are left as they were from propagation.
+   This isn't done if the iterations stopped because the time in dl_end 
+   was reached.
+
+   The setup procedure immediately below finds the Tanner graph for the 
+   decoder's code, allocates space for the messages, finds the layers (if 
+   the schedule is Layered), allocates space for the heap of checks (if it
+   is Residual), sets up for OSD (if osd is set), and outputs headers for 
+   the detailed trace file, if required.
+*/
+
+void prprp_decode_setup 
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  graph_setup(d);
+
+  d->edge_pr = chk_alloc (tanner_edges(d->graph), sizeof *d->edge_pr);
+  d->edge_lr = chk_alloc (tanner_edges(d->graph), sizeof *d->edge_lr);
+  d->prp_syn = chk_alloc (tanner_rows(d->graph), sizeof *d->prp_syn);
+
+  if (d->schedule==Flooding)
+  { kern_setup(d);
+  }
+
+  if (d->schedule==Layered)
+  { d->prp_post = chk_alloc (tanner_cols(d->graph), sizeof *d->prp_post);
+    d->bit_mark = chk_alloc (tanner_cols(d->graph), sizeof *d->bit_mark);
+    layer_setup(d);
+  }
+
+  if (d->schedule==Residual)
+  { d->prp_post = chk_alloc (tanner_cols(d->graph), sizeof *d->prp_post);
+    d->res_in   = chk_alloc (tanner_edges(d->graph), sizeof *d->res_in);
+    d->res_new  = chk_alloc (tanner_edges(d->graph), sizeof *d->res_new);
+    d->res_sent = chk_alloc (tanner_edges(d->graph), sizeof *d->res_sent);
+    d->res_key  = chk_alloc (tanner_rows(d->graph), sizeof *d->res_key);
+    d->res_exact= chk_alloc (tanner_rows(d->graph), sizeof *d->res_exact);
+    d->res_heap = chk_alloc (tanner_rows(d->graph), sizeof *d->res_heap);
+    d->res_hpos = chk_alloc (tanner_rows(d->graph), sizeof *d->res_hpos);
+  }
+
+  if (d->osd)
+  { osd_setup(d);
+  }
+
+  if (d->table==2)
+  { trace_header();
+  }
+}
+
+unsigned prprp_decode
+( ldpc_decoder *d,	/* Decoder to use */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb		/* Place to store bit probabilities */
+)
+{ 
+  int n, c, since;
+
+  /* Initialize probability and likelihood ratios, and find initial guess. */
+
+  initprp(d,lratio,dblk,bprb);
+
+  if (d->schedule==Residual)
+  { initres(d);
+  }
+
+  /* Do up to abs(max_iter) iterations of probability propagation, stopping
+     early if a codeword is found, or if progress has stopped, unless 
+     max_iter is negative. */
+
+  d->stopped = 0;
+  since = 0;
+
+  for (n = 0; ; n++)
+  { 
+    c = d->prp_unsat;
+
+    if (d->table==2)
+    { trace_iter(d,n,c,lratio,dblk,bprb);
+    }
+   
+    if (n==d->max_iter || n==-d->max_iter || (d->max_iter>0 && c==0))
+    { break; 
+    }
+
+    if (d->dl_end>0 && dec_clock()>=d->dl_end)
+    { d->late = 1;
+      break;
+    }
+
+    if (d->stop_after>0 && d->max_iter>0)
+    { if (n>=2 && (d->prp_hash==d->stop_hash[0] 
+                    || d->prp_hash==d->stop_hash[1]))
+      { since += 1;
+        if (since>=d->stop_after)
+        { d->stopped = 1;
+          break;
+        }
+      }
+      else
+      { since = 0;
+      }
+      d->stop_hash[1] = d->stop_hash[0];
+      d->stop_hash[0] = d->prp_hash;
+    }
+
+    if (d->schedule==Layered)
+    { iterlayer(d,lratio,dblk,bprb);
+    }
+    else if (d->schedule==Residual)
+    { iterres(d,lratio,dblk,bprb);
+    }
+    else
+    { iterprp(d,lratio,dblk,bprb);
+    }
+  }
+
+  /* Look for a codeword by ordered-statistics decoding if none was found. */
+
+  if (d->osd && d->prp_unsat!=0 && !d->late)
+  { osd_decode(d,lratio,dblk,bprb);
+    d->prp_unsat = check_packed(d->code->packed,dblk,d->prp_syn,d->chk_words);
+  }
+
+  memcpy (pchk, d->prp_syn, tanner_rows(d->graph));
+
+  return n;
+}
+
+
+/* FIND THE LAYERS FOR THE LAYERED SCHEDULE.  If layer_size is non-zero,
+   each layer is a group of that many consecutive rows (the last possibly
+   smaller), which for a quasi-cyclic code with circulants of that size 
+   gives layers in which no two rows share a bit.  Otherwise, the layer 
+   for each row is read from layer_file, which should contain M non-negative
+   integers.  Layers are processed in order of increasing layer number. */
+
+static void layer_setup
+( ldpc_decoder *d	/* Decoder being set up */
+)
+{
+  tanner_graph *G;
+  int *lay, *fill;
+  int *layer_start, *layer_row;
+  char *layer_disjoint, *bit_mark;
+  int M, i, k, l, e, L, n_layers;
+  char *layer_file;
+  FILE *f;
+
+  G = d->graph;
+  M = tanner_rows(G);
+  layer_file = d->layer_file;
+  bit_mark = d->bit_mark;
+
+  lay = chk_alloc (M, sizeof *lay);
+
+  if (d->layer_size>0)
+  { for (i = 0; i<M; i++) 
+    { lay[i] = i / d->layer_size;
+    }
+  }
+  else
+  { f = open_file_std(layer_file,"r");
+    if (f==NULL)
+    { fprintf(stderr,"Can't open layer file: %s\n",layer_file);
+      exit(1);
+    }
+    for (i = 0; i<M; i++)
+    { if (fscanf(f,"%d",&lay[i])!=1 || lay[i]<0)
+      { fprintf(stderr,"Layer file %s is garbled or too short\n",layer_file);
+        exit(1);
+      }
+    }
+    fclose(f);
+  }
+
+  L = 0;
+  for (i = 0; i<M; i++)
+  { if (lay[i]>=L) L = lay[i]+1;
+  }
+
+  /* Sort rows by layer, dropping layer numbers that aren't used. */
+
+  fill = chk_alloc (L+1, sizeof *fill);
+  for (i = 0; i<M; i++) 
+  { fill[lay[i]+1] += 1;
+  }
+  n_layers = 0;
+  for (l = 0; l<L; l++)
+  { if (fill[l+1]>0) n_layers += 1;
+    fill[l+1] += fill[l];
+  }
+
+  layer_row = chk_alloc (M, sizeof *layer_row);
+  layer_start = chk_alloc (n_layers+1, sizeof *layer_start);
+  layer_disjoint = chk_alloc (n_layers, sizeof *layer_disjoint);
+
+  k = 0;
+  for (l = 0; l<L; l++)
+  { if (fill[l+1]>fill[l]) 
+    { layer_start[k] = fill[l];
+      k += 1;
+    }
+  }
+  layer_start[n_layers] = M;
+
+  for (i = 0; i<M; i++)
+  { layer_row[fill[lay[i]]] = i;
+    fill[lay[i]] += 1;
+  }
+
+  /* See which layers have rows that share no bits, which allows a faster
+     update of the bit probabilities. */
+
+  for (l = 0; l<n_layers; l++)
+  { layer_disjoint[l] = 1;
+    for (k = layer_start[l]; k<layer_start[l+1]; k++)
+    { i = layer_row[k];
+      for (e = G->row_start[i]; e<G->row_start[i+1]; e++)
+      { if (bit_mark[G->edge_col[e]]) layer_disjoint[l] = 0;
+        bit_mark[G->edge_col[e]] = 1;
+      }
+    }
+    for (k = layer_start[l]; k<layer_start[l+1]; k++)
+    { i = layer_row[k];
+      for (e = G->row_start[i]; e<G->row_start[i+1]; e++)
+      { bit_mark[G->edge_col[e]] = 0;
+      }
+    }
+  }
+
+  free(lay);
+  free(fill);
+
+  d->n_layers = n_layers;
+  d->layer_start = layer_start;
+  d->layer_row = layer_row;
+  d->layer_disjoint = layer_disjoint;
+}
+
+
+/* CHANGE A BIT IN THE TENTATIVE DECODING.  Flips the parity checks that
+   the bit is in, keeping count of how many are not satisfied. */
+
+static void prp_flip
+( ldpc_decoder *d,	/* Decoder, with parity checks for the decoding */
+  char *dblk,		/* Tentative decoding */
+  int j			/* Bit to change */
+)
+{
+  tanner_graph *G;
+  char *syn;
+  int k, i;
+
+  G = d->graph;
+  syn = d->prp_syn;
+
+  dblk[j] ^= 1;
+  d->prp_hash ^= bit_key(j);
+
+  for (k = G->col_start[j]; k<G->col_start[j+1]; k++)
+  { i = G->edge_row[G->col_edge[k]];
+    syn[i] ^= 1;
+    d->prp_unsat += syn[i] ? 1 : -1;
+  }
+}
+
+
+/* FIND THE KEY FOR A BIT IN THE HASH OF A GUESS.  The hash of a guess is
+   the exclusive-or of the keys for the bits that are one, so it can be 
+   updated when a bit changes.  The keys are pseudo-random, found by 
+   mixing the bit's index as in the "splitmix64" generator. */
+
+static uint64_t bit_key
+( int j			/* Index of bit */
+)
+{
+  uint64_t z;
+
+  z = (uint64_t) j * 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z>>30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z>>27)) * 0x94d049bb133111ebULL;
+  return z ^ (z>>31);
+}
+
+
+/* INITIALIZE PROBABILITY PROPAGATION.  Stores initial ratios, probabilities,
+   and guess at decoding, and finds the parity checks for the guess. */
+
+void initprp
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  double *bprb		/* Place to store bit probabilities, 0 if not wanted */
+)
+{ 
+  tanner_graph *G;
+  int N;
+  int j, k;
+
+  G = d->graph;
+  N = tanner_cols(G);
+
+  for (j = 0; j<N; j++)
+  { for (k = G->col_start[j]; k<G->col_start[j+1]; k++)
+    { d->edge_pr[G->col_edge[k]] = lratio[j];
+    }
+    if (d->prp_post) d->prp_post[j] = lratio[j];
+    if (bprb) bprb[j] = 1 - 1/(1+lratio[j]);
+    dblk[j] = lratio[j]>=1;
+  }
+
+  d->prp_hash = 0;
+  for (j = 0; j<N; j++)
+  { if (dblk[j]) d->prp_hash ^= bit_key(j);
+  }
+
+  for (k = 0; k<tanner_edges(G); k++)
+  { d->edge_lr[k] = 1;
+  }
+
+  d->prp_unsat = check_packed(d->code->packed,dblk,d->prp_syn,d->chk_words);
+}
+
+
+/* DO ONE ITERATION OF PROBABILITY PROPAGATION.  The likelihood ratios are
+   recomputed a row at a time, streaming through the edge arrays in order.
+   The probability ratios are then recomputed a column at a time, using the
+   column-to-edge index of the Tanner graph.
+
+   Rows and columns are visited in order of degree (see kern_setup below),
+   and each run of Batch_vec rows or columns with the same degree is done 
+   together by prp_rows or prp_cols, whose loops over the rows or columns
+   can be done with SIMD instructions.  Any others are done one at a time. 
+   The results are the same either way. */
+
+void iterprp
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  double *bprb		/* Place to store bit probabilities, 0 if not wanted */
+)
+{
+  tanner_graph *G;
+  double *epr, *elr;
+  double dl, t;
+  int *rows, *cols;
+  int N, M;
+  int i, j, e, a, b, p, w;
+
+  G = d->graph;
+  M = tanner_rows(G);
+  N = tanner_cols(G);
+
+  epr = d->edge_pr;
+  elr = d->edge_lr;
+  rows = d->kern_rows;
+  cols = d->kern_cols;
+
+  /* Recompute likelihood ratios. */
+
+  for (p = 0; p<M; p++)
+  { i = rows[p];
+    w = tanner_row_degree(G,i);
+    if (p+Batch_vec<=M && w<=Kern_max 
+         && tanner_row_degree(G,rows[p+Batch_vec-1])==w)
+    { prp_rows(d,rows+p,w);
+      p += Batch_vec-1;
+      continue;
+    }
+    a = G->row_start[i];
+    b = G->row_start[i+1];
+    dl = 1;
+    for (e = a; e<b; e++)
+    { elr[e] = dl;
+      dl *= 2/(1+epr[e]) - 1;
+    }
+    dl = 1;
+    for (e = b-1; e>=a; e--)
+    { t = elr[e] * dl;
+      elr[e] = (1-t)/(1+t);
+      dl *= 2/(1+epr[e]) - 1;
+    }
+  }
+
+  /* Recompute probability ratios.  Also find the next guess based on the
+     individually most likely values. */
+
+  for (p = 0; p<N; p++)
+  { j = cols[p];
+    w = tanner_col_degree(G,j);
+    if (p+Batch_vec<=N && w<=Kern_max 
+         && tanner_col_degree(G,cols[p+Batch_vec-1])==w)
+    { prp_cols(d,lratio,dblk,bprb,cols+p,w);
+      p += Batch_vec-1;
+      continue;
+    }
+    prp_bit(d,lratio,dblk,bprb,j);
+  }
+}
+
+
+/* SORT ROWS AND COLUMNS BY DEGREE, for the kernels used by iterprp.  Those
+   with the same degree stay in their original order, so for a code with 
+   all rows of the same degree the rows are done in order, as are the 
+   columns if they all have the same degree. */
+
+static void degree_order
+( int n,		/* Number of rows or columns */
+  int *start,		/* Start of each in the edge arrays, plus the end */
+  int *order		/* Place to store them in order of degree */
+)
+{
+  int *fill;
+  int i, w, mw;
+
+  mw = 0;
+  for (i = 0; i<n; i++)
+  { if (start[i+1]-start[i]>mw) mw = start[i+1]-start[i];
+  }
+
+  fill = chk_alloc (mw+2, sizeof *fill);
+  for (i = 0; i<n; i++)
+  { fill[start[i+1]-start[i]+1] += 1;
+  }
+  for (w = 0; w<=mw; w++)
+  { fill[w+1] += fill[w];
+  }
+  for (i = 0; i<n; i++)
+  { order[fill[start[i+1]-start[i]]++] = i;
+  }
+
+  free(fill);
+}
+
+static void kern_setup
+( ldpc_decoder *d	/* Decoder, with its Tanner graph */
+)
+{
+  tanner_graph *G;
+
+  G = d->graph;
+
+  d->kern_rows = chk_alloc (tanner_rows(G), sizeof *d->kern_rows);
+  d->kern_cols = chk_alloc (tanner_cols(G), sizeof *d->kern_cols);
+
+  degree_order (tanner_rows(G), G->row_start, d->kern_rows);
+  degree_order (tanner_cols(G), G->col_start, d->kern_cols);
+}
+
+
+/* RECOMPUTE LIKELIHOOD RATIOS FOR BATCH_VEC ROWS OF THE SAME DEGREE.  The
+   probability ratios for the edges of the rows are gathered so that the 
+   values for the k'th edge of each row are together, the likelihood ratios
+   are then computed as for a single row in iterprp, with the innermost 
+   loop being over the rows, and then scattered back to their edges.  The 
+   factor for each edge is found only once, but is the same as is found
+   twice in iterprp. */
+
+static void prp_rows
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  int *rows,		/* The rows to do */
+  int w			/* Degree of all these rows, at most Kern_max */
+)
+{
+  double f[Kern_max*Batch_vec], q[Kern_max*Batch_vec];
+  double dl[Batch_vec];
+  int a[Batch_vec];
+  double *epr, *elr, t;
+  int k, l;
+
+  epr = d->edge_pr;
+  elr = d->edge_lr;
+
+  for (l = 0; l<Batch_vec; l++)
+  { a[l] = d->graph->row_start[rows[l]];
+  }
+
+  for (k = 0; k<w; k++)
+  { for (l = 0; l<Batch_vec; l++)
+    { f[k*Batch_vec+l] = epr[a[l]+k];
+    }
+  }
+
+  for (l = 0; l<Batch_vec; l++) dl[l] = 1;
+  for (k = 0; k<w; k++)
+  { for (l = 0; l<Batch_vec; l++)
+    { q[k*Batch_vec+l] = dl[l];
+      f[k*Batch_vec+l] = 2/(1+f[k*Batch_vec+l]) - 1;
+      dl[l] *= f[k*Batch_vec+l];
+    }
+  }
+
+  for (l = 0; l<Batch_vec; l++) dl[l] = 1;
+  for (k = w-1; k>=0; k--)
+  { for (l = 0; l<Batch_vec; l++)
+    { t = q[k*Batch_vec+l] * dl[l];
+      q[k*Batch_vec+l] = (1-t)/(1+t);
+      dl[l] *= f[k*Batch_vec+l];
+    }
+  }
+
+  for (k = 0; k<w; k++)
+  { for (l = 0; l<Batch_vec; l++)
+    { elr[a[l]+k] = q[k*Batch_vec+l];
+    }
+  }
+}
+
+
+/* RECOMPUTE PROBABILITY RATIOS FOR BATCH_VEC COLUMNS OF THE SAME DEGREE.
+   Done as in prp_bit, but with the likelihood ratios for the columns' edges
+   gathered so that the innermost loops are over the columns. */
+
+static void prp_cols
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Tentative decoding */
+  double *bprb,		/* Place to store bit probabilities, 0 if not wanted */
+  int *cols,		/* The columns to do */
+  int w			/* Degree of all these columns, at most Kern_max */
+)
+{
+  double p[Kern_max*Batch_vec], q[Kern_max*Batch_vec];
+  double pr[Batch_vec];
+  int e[Kern_max*Batch_vec];
+  tanner_graph *G;
+  double t;
+  int j, k, l;
+
+  G = d->graph;
+
+  for (k = 0; k<w; k++)
+  { for (l = 0; l<Batch_vec; l++)
+    { e[k*Batch_vec+l] = G->col_edge[G->col_start[cols[l]]+k];
+      q[k*Batch_vec+l] = d->edge_lr[e[k*Batch_vec+l]];
+    }
+  }
+
+  for (l = 0; l<Batch_vec; l++)
+  { pr[l] = lratio[cols[l]];
+  }
+  for (k = 0; k<w; k++)
+  { for (l = 0; l<Batch_vec; l++)
+    { p[k*Batch_vec+l] = pr[l];
+      pr[l] *= q[k*Batch_vec+l];
+    }
+  }
+
+  for (l = 0; l<Batch_vec; l++)
+  { j = cols[l];
+    t = isnan(pr[l]) ? 1 : pr[l];
+    if (bprb) bprb[j] = 1 - 1/(1+t);
+    if (dblk[j] != (t>=1)) prp_flip(d,dblk,j);
+    pr[l] = 1;
+  }
+
+  for (k = w-1; k>=0; k--)
+  { for (l = 0; l<Batch_vec; l++)
+    { t = p[k*Batch_vec+l] * pr[l];
+      p[k*Batch_vec+l] = isnan(t) ? 1 : t;
+      pr[l] *= q[k*Batch_vec+l];
+    }
+  }
+
+  for (k = 0; k<w; k++)
+  { for (l = 0; l<Batch_vec; l++)
+    { d->edge_pr[e[k*Batch_vec+l]] = p[k*Batch_vec+l];
+    }
+  }
+}
+
+
+/* RECOMPUTE THE PROBABILITY RATIOS FOR ONE BIT.  The ratios sent to each
+   check are found as products over the other checks, and the decoding for
+   the bit is changed if necessary.  The overall probability ratio for the
+   bit is returned. */
+
+static double prp_bit
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Tentative decoding */
+  double *bprb,		/* Place to store bit probabilities, 0 if not wanted */
+  int j			/* Bit to recompute */
+)
+{
+  tanner_graph *G;
+  double *epr, *elr;
+  double pr, p;
+  int *ce;
+  int k, e, a, b;
+
+  G = d->graph;
+  epr = d->edge_pr;
+  elr = d->edge_lr;
+
+  ce = G->col_edge;
+  a = G->col_start[j];
+  b = G->col_start[j+1];
+  pr = lratio[j];
+  for (k = a; k<b; k++)
+  { e = ce[k];
+    epr[e] = pr;
+    pr *= elr[e];
+  }
+  if (isnan(pr))
+  { pr = 1;
+  }
+  if (bprb) bprb[j] = 1 - 1/(1+pr);
+  if (dblk[j] != (pr>=1)) prp_flip(d,dblk,j);
+  p = 1;
+  for (k = b-1; k>=a; k--)
+  { e = ce[k];
+    epr[e] *= p;
+    if (isnan(epr[e])) 
+    { epr[e] = 1;
+    }
+    p *= elr[e];
+  }
+
+  return pr;
+}
+
+
+/* DO ONE ITERATION OF PROBABILITY PROPAGATION WITH THE LAYERED SCHEDULE.
+   For each layer, the probability ratio for each bit in each check of the 
+   layer with respect to that check is first found by dividing the bit's 
+   overall probability ratio by the check's old likelihood ratio (or as a
+   product over the bit's other checks, if that division isn't possible),
+   and stored in edge_pr.  The checks' likelihood ratios are then recomputed
+   as in iterprp.  Since rows in the same layer don't depend on each other,
+   these computations could be done in parallel.  Finally, the overall 
+   probability ratios for the bits in the layer are updated. */
+
+void iterlayer
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  double *bprb		/* Place to store bit probabilities, 0 if not wanted */
+)
+{
+  tanner_graph *G;
+  double *epr, *elr, *prp_post;
+  int *layer_start, *layer_row;
+  char *layer_disjoint, *bit_mark;
+  double pr, dl, t;
+  int l, k, i, j, e, a, b, f;
+
+  G = d->graph;
+
+  epr = d->edge_pr;
+  elr = d->edge_lr;
+  prp_post = d->prp_post;
+
+  layer_start = d->layer_start;
+  layer_row = d->layer_row;
+  layer_disjoint = d->layer_disjoint;
+  bit_mark = d->bit_mark;
+
+  for (l = 0; l<d->n_layers; l++)
+  {
+    /* Recompute likelihood ratios for checks in this layer. */
+
+    for (k = layer_start[l]; k<layer_start[l+1]; k++)
+    { i = layer_row[k];
+      a = G->row_start[i];
+      b = G->row_start[i+1];
+      for (e = a; e<b; e++)
+      { j = G->edge_col[e];
+        if (elr[e]>0 && elr[e]<HUGE_VAL)
+        { pr = prp_post[j] / elr[e];
+        }
+        else
+        { pr = NAN;
+        }
+        if (isnan(pr))
+        { pr = lratio[j];
+          for (f = G->col_start[j]; f<G->col_start[j+1]; f++)
+          { if (G->col_edge[f]!=e) pr *= elr[G->col_edge[f]];
+          }
+          if (isnan(pr)) 
+          { pr = 1;
+          }
+        }
+        epr[e] = pr;
+      }
+      dl = 1;
+      for (e = a; e<b; e++)
+      { elr[e] = dl;
+        dl *= 2/(1+epr[e]) - 1;
+      }
+      dl = 1;
+      for (e = b-1; e>=a; e--)
+      { t = elr[e] * dl;
+        elr[e] = (1-t)/(1+t);
+        dl *= 2/(1+epr[e]) - 1;
+      }
+    }
+
+    /* Update the overall probability ratios for bits in this layer.  If
+       no bit is in two checks in the layer, this just needs the ratio with
+       respect to the one check times its new likelihood ratio.  Otherwise,
+       the product over all the bit's checks is found. */
+
+    for (k = layer_start[l]; k<layer_start[l+1]; k++)
+    { i = layer_row[k];
+      for (e = G->row_start[i]; e<G->row_start[i+1]; e++)
+      { j = G->edge_col[e];
+        if (layer_disjoint[l])
+        { pr = epr[e] * elr[e];
+        }
+        else
+        { if (bit_mark[j]) continue;
+          bit_mark[j] = 1;
+          pr = lratio[j];
+          for (f = G->col_start[j]; f<G->col_start[j+1]; f++)
+          { pr *= elr[G->col_edge[f]];
+          }
+        }
+        if (isnan(pr))
+        { pr = 1;
+        }
+        prp_post[j] = pr;
+      }
+    }
+
+    if (!layer_disjoint[l])
+    { for (k = layer_start[l]; k<layer_start[l+1]; k++)
+      { i = layer_row[k];
+        for (e = G->row_start[i]; e<G->row_start[i+1]; e++)
+        { bit_mark[G->edge_col[e]] = 0;
+        }
+      }
+    }
+  }
+
+  /* Find the next guess based on the individually most likely values. */
+
+  for (j = 0; j<tanner_cols(G); j++)
+  { pr = prp_post[j];
+    if (bprb) bprb[j] = 1 - 1/(1+pr);
+    if (dblk[j] != (pr>=1)) prp_flip(d,dblk,j);
+  }
+}
+
+
+/* PROBABILITY PROPAGATION WITH THE RESIDUAL SCHEDULE.  The checks are kept
+   in a heap ordered by res_key, which is an upper bound on how much the 
+   messages from the check would change if it were updated now.  Each step
+   takes the check at the top of the heap.  If its key is only a bound, the
+   new messages from the check are found, along with the exact change, and
+   the check is put back in the heap with this as its key.  Otherwise, its 
+   new messages are sent, the probability ratios for its bits are 
+   recomputed, and the keys of the other checks of these bits are increased
+   by the change in the messages they get from the bits.  Checks whose 
+   inputs have settled are therefore not updated again, and updates go 
+   first to where the messages are changing the most.  This reduces the 
+   number of check updates, but not the time, since each update sends 
+   messages to all the bits of the check at once, recomputing each bit, 
+   and moves their other checks in the heap, which costs several times as
+   much as the update of the check itself.
+
+   The messages are here not handled as likelihood and probability ratios,
+   but rather as 2/(1+r)-1 for a ratio r, which is the difference of the 
+   probabilities of the bit being 0 and 1, as found in the course of 
+   computing the likelihood ratios in iterprp.  The messages from bits are
+   kept in this form in res_in, the new messages from checks in res_new,
+   and the messages last sent by checks in res_sent.  Since a message from
+   a check is a product of such differences, each of magnitude at most one,
+   changing one of them changes the product by no more than the change in
+   it, so adding these changes gives an upper bound on the change in the
+   check's messages.  Changes in this form are also small for messages that
+   are already nearly certain, which matter little. */
+
+/* FIND THE NEW MESSAGES FOR A CHECK, and the largest change from the 
+   messages last sent. */
+
+static void res_row
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  int i			/* Check to recompute */
+)
+{
+  tanner_graph *G;
+  double *in, *nt, *st;
+  double dl, t, r, m;
+  int e, a, b;
+
+  G = d->graph;
+  in = d->res_in;
+  nt = d->res_new;
+  st = d->res_sent;
+
+  a = G->row_start[i];
+  b = G->row_start[i+1];
+
+  dl = 1;
+  for (e = a; e<b; e++)
+  { nt[e] = dl;
+    dl *= in[e];
+  }
+  dl = 1;
+  m = 0;
+  for (e = b-1; e>=a; e--)
+  { t = nt[e] * dl;
+    nt[e] = t;
+    dl *= in[e];
+    r = fabs(t-st[e]);
+    if (r>m) m = r;
+  }
+
+  d->res_key[i] = m;
+  d->res_exact[i] = 1;
+}
+
+
+/* INITIALIZE FOR THE RESIDUAL SCHEDULE.  Done after initprp, finding the 
+   new messages for all checks and putting them in the heap. */
+
+void initres
+( ldpc_decoder *d	/* Decoder, with Tanner graph and space for messages */
+)
+{
+  int M, i, e;
+
+  M = tanner_rows(d->graph);
+
+  for (e = 0; e<tanner_edges(d->graph); e++)
+  { d->res_in[e] = 2/(1+d->edge_pr[e]) - 1;
+    d->res_sent[e] = 0;
+  }
+
+  for (i = 0; i<M; i++)
+  { res_row(d,i);
+    d->res_heap[i] = i;
+    d->res_hpos[i] = i;
+  }
+  for (i = M/2-1; i>=0; i--)
+  { heap_down(d->res_heap,d->res_hpos,d->res_key,M,i);
+  }
+}
+
+
+/* DO ONE ITERATION WITH THE RESIDUAL SCHEDULE.  Does as many check updates
+   as there are checks, stopping early if no check would send messages any 
+   different from before, or if max_iter is positive and the decoding is a
+   codeword. */
+
+void iterres
+( ldpc_decoder *d,	/* Decoder, set up by initres */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  double *bprb		/* Place to store bit probabilities, 0 if not wanted */
+)
+{
+  tanner_graph *G;
+  double *epr, *elr, *in, *nt, *st, *key;
+  int *heap, *hpos;
+  char *exact;
+  double t;
+  int M, n, i, j, e, f, k;
+
+  G = d->graph;
+  M = tanner_rows(G);
+
+  epr = d->edge_pr;
+  elr = d->edge_lr;
+  in = d->res_in;
+  nt = d->res_new;
+  st = d->res_sent;
+  key = d->res_key;
+  exact = d->res_exact;
+  heap = d->res_heap;
+  hpos = d->res_hpos;
+
+  n = 0;
+
+  while (n<M)
+  { 
+    if (d->max_iter>0 && d->prp_unsat==0) break;
+
+    i = heap[0];
+    if (key[i]==0) break;
+
+    /* If the check's key is just a bound, find its new messages, and put
+       it back with the exact change. */
+
+    if (!exact[i])
+    { res_row(d,i);
+      heap_down(heap,hpos,key,M,0);
+      continue;
+    }
+
+    /* Send the new messages from check i, recompute the ratios for its 
+       bits, and increase the keys of their other checks. */
+
+    key[i] = 0;
+    heap_down(heap,hpos,key,M,0);
+
+    for (e = G->row_start[i]; e<G->row_start[i+1]; e++)
+    { if (nt[e]==st[e]) continue;
+      st[e] = nt[e];
+      elr[e] = (1-nt[e])/(1+nt[e]);
+      j = G->edge_col[e];
+      d->prp_post[j] = prp_bit(d,lratio,dblk,bprb,j);
+      for (k = G->col_start[j]; k<G->col_start[j+1]; k++)
+      { f = G->col_edge[k];
+        if (f==e) continue;
+        t = 2/(1+epr[f]) - 1;
+        key[G->edge_row[f]] += fabs(t-in[f]);
+        exact[G->edge_row[f]] = 0;
+        in[f] = t;
+        heap_up(heap,hpos,key,hpos[G->edge_row[f]]);
+      }
+    }
+
+    n += 1;
+  }
+}
+
+
+/* ORDERED-STATISTICS DECODING.  Finds a codeword for a block that 
+   probability propagation failed to decode, using the final bit 
+   probabilities to decide which bits are reliable.  The bits are sorted 
+   from least to most reliable (by how far their probability is from 1/2), 
+   and a set of parity bits is found as make-gen does for a dense generator
+   matrix, but with the columns of H in this order, so that the parity bits
+   are mostly unreliable ones, and the other bits (the information bits) are
+   mostly reliable.  Bits that make-gen would fix at zero because of 
+   redundant checks are made information bits.
+
+   The information bits are first set to the decoding from propagation, and
+   the parity bits found from them (OSD-0).  Every way of flipping up to 
+   osd_order information bits is then tried, and the codeword kept is the
+   one that is most likely given the received data - ie, the one with the 
+   smallest sum of |log lratio[j]| over bits j that differ from the hard 
+   decisions from the data.  This codeword is stored in dblk.
+
+   The time for a block is dominated by the elimination, which takes time
+   proportional to M^2 N, and the search, in which the number of codewords 
+   tried grows as (N-M)^osd_order.  Since this is done only for blocks where
+   propagation fails, it adds little to the average time if these are rare.
+
+   The setup procedure immediately below finds the rank of H, which doesn't
+   depend on the order of its columns, and so fixes the number of parity 
+   bits, and allocates space. */
+
+#define Osd_max_cost 1e10	/* Cost of changing a bit known for certain */
+
+typedef struct		/* Bit and its reliability, for sorting */
+{ double rel;
+  int bit;
+} osd_key;
+
+void osd_setup
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  mod2sparse *H;
+  int M, N, K, W, R;
+
+  H = d->code->H;
+  M = mod2sparse_rows(H);
+  N = mod2sparse_cols(H);
+
+  d->osd_H  = mod2dense_allocate(M,N);
+  d->osd_DH = mod2dense_allocate(M,N);
+  d->osd_A  = mod2dense_allocate(M,N);
+  d->osd_A2 = mod2dense_allocate(M,N);
+  d->osd_AI = mod2dense_allocate(M,M);
+
+  d->osd_rows = chk_alloc (M, sizeof *d->osd_rows);
+  d->osd_rows_inv = chk_alloc (M, sizeof *d->osd_rows_inv);
+  d->osd_cols = chk_alloc (N, sizeof *d->osd_cols);
+  d->osd_perm = chk_alloc (N, sizeof *d->osd_perm);
+
+  mod2sparse_to_dense(H,d->osd_H);
+  mod2dense_copy(d->osd_H,d->osd_DH);
+  R = mod2dense_invert_selected(d->osd_DH,d->osd_A2,d->osd_rows,d->osd_cols);
+
+  d->osd_rank = M-R;
+  K = N-d->osd_rank;
+  W = packed_words(d->osd_rank);
+
+  d->osd_B = mod2dense_allocate(M,K);
+  d->osd_G = mod2dense_allocate(M,K);
+
+  d->osd_info = chk_alloc (K, sizeof *d->osd_info);
+  d->osd_gcol = chk_alloc (K*W, sizeof *d->osd_gcol);
+  d->osd_par = chk_alloc ((d->osd_order+1)*W, sizeof *d->osd_par);
+  d->osd_ypar = chk_alloc (W, sizeof *d->osd_ypar);
+  d->osd_pcost = chk_alloc (d->osd_rank, sizeof *d->osd_pcost);
+  d->osd_icost = chk_alloc (K, sizeof *d->osd_icost);
+  d->osd_flip = chk_alloc (d->osd_order+1, sizeof *d->osd_flip);
+  d->osd_best = chk_alloc (d->osd_order+1, sizeof *d->osd_best);
+}
+
+
+/* COMPARE RELIABILITIES OF BITS, for sorting with qsort.  Ties are broken 
+   by bit index, so the order doesn't depend on the sorting procedure. */
+
+static int osd_compare
+( const void *a,
+  const void *b
+)
+{
+  const osd_key *x = a, *y = b;
+
+  return x->rel<y->rel ? -1 : x->rel>y->rel ? 1 : x->bit - y->bit;
+}
+
+
+/* FIND COST OF CHANGING A BIT FROM THE HARD DECISION FROM THE DATA. */
+
+static double osd_cost
+( double lr		/* Likelihood ratio for the bit */
+)
+{
+  double c;
+
+  c = fabs(log(lr));
+
+  return c>Osd_max_cost ? Osd_max_cost : c;
+}
+
+
+/* SEARCH CODEWORDS WITH MORE INFORMATION BITS FLIPPED.  The parity bits
+   for the information bits flipped so far, which are in osd_flip, are in
+   osd_par at the given depth.  Codewords with more bits flipped, at 
+   indexes of start or more, are tried by recursive calls. */
+
+static void osd_search
+( ldpc_decoder *d,	/* Decoder, set up for the search */
+  int depth,		/* Number of information bits flipped so far */
+  int start,		/* First information bit that may be flipped next */
+  double icost		/* Cost of the information bits */
+)
+{
+  uint64_t *par, *npar, *g, x;
+  double cost;
+  int K, W, t, k;
+
+  K = tanner_cols(d->graph) - d->osd_rank;
+  W = packed_words(d->osd_rank);
+  par = d->osd_par + depth*W;
+
+  cost = icost;
+  for (k = 0; k<W; k++)
+  { for (x = par[k] ^ d->osd_ypar[k]; x!=0; x &= x-1)
+    { cost += d->osd_pcost[64*k+lowbit64(x)];
+    }
+  }
+
+  if (cost<d->osd_best_cost)
+  { d->osd_best_cost = cost;
+    d->osd_nbest = depth;
+    for (k = 0; k<depth; k++)
+    { d->osd_best[k] = d->osd_flip[k];
+    }
+  }
+
+  if (depth==d->osd_order) 
+  { return;
+  }
+
+  npar = par + W;
+  for (t = start; t<K; t++)
+  { g = d->osd_gcol + t*W;
+    for (k = 0; k<W; k++)
+    { npar[k] = par[k] ^ g[k];
+    }
+    d->osd_flip[depth] = t;
+    osd_search (d, depth+1, t+1, icost + d->osd_icost[t]);
+  }
+}
+
+
+/* DECODE A BLOCK BY ORDERED-STATISTICS DECODING. */
+
+void osd_decode
+( ldpc_decoder *d,	/* Decoder, set up for OSD */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Decoding, replaced by the codeword found */
+  double *bprb		/* Bit probabilities, used as reliabilities */
+)
+{
+  osd_key *key;
+  int *perm, *cols, *info;
+  uint64_t *par, *g;
+  double icost, c;
+  int M, N, K, W, r;
+  int i, j, k, t;
+
+  M = tanner_rows(d->graph);
+  N = tanner_cols(d->graph);
+  r = d->osd_rank;
+  K = N-r;
+  W = packed_words(r);
+
+  perm = d->osd_perm;
+  cols = d->osd_cols;
+  info = d->osd_info;
+  par = d->osd_par;
+
+  /* Sort the bits from least to most reliable. */
+
+  key = chk_alloc (N, sizeof *key);
+  for (j = 0; j<N; j++)
+  { key[j].rel = fabs(bprb[j]-0.5);
+    key[j].bit = j;
+  }
+  qsort (key, N, sizeof *key, osd_compare);
+  for (j = 0; j<N; j++)
+  { perm[j] = key[j].bit;
+  }
+  free(key);
+
+  /* Find the parity bits, and the parity bits that go with each information
+     bit, as make-gen does, with the columns of H in order of reliability. */
+
+  mod2dense_copycols(d->osd_H,d->osd_DH,perm);
+  if (mod2dense_invert_selected(d->osd_DH,d->osd_A2,d->osd_rows,cols)!=M-r)
+  { abort();
+  }
+
+  for (i = 0; i<M; i++)
+  { d->osd_rows_inv[d->osd_rows[i]] = i;
+  }
+
+  mod2dense_copyrows(d->osd_A2,d->osd_A,d->osd_rows);
+  mod2dense_copycols(d->osd_A,d->osd_A2,cols);
+  mod2dense_copycols(d->osd_A2,d->osd_AI,d->osd_rows_inv);
+
+  for (t = 0; t<K; t++)
+  { info[t] = perm[cols[r+t]];
+  }
+
+  mod2dense_copycols(d->osd_H,d->osd_B,info);
+  mod2dense_multiply(d->osd_AI,d->osd_B,d->osd_G);
+
+  g = d->osd_gcol;
+  for (k = 0; k<K*W; k++) 
+  { g[k] = 0;
+  }
+  for (t = 0; t<K; t++)
+  { for (i = 0; i<r; i++)
+    { if (mod2dense_get(d->osd_G,i,t))
+      { g[t*W+(i>>6)] |= (uint64_t)1 << (i&63);
+      }
+    }
+  }
 
+  /* Find the costs of changing bits from the hard decisions from the data,
+     and the parity bits for the information bits from propagation. */
+
+  for (k = 0; k<W; k++)
+  { par[k] = 0;
+    d->osd_ypar[k] = 0;
+  }
+
+  for (i = 0; i<r; i++)
+  { j = perm[cols[i]];
+    if (lratio[j]>1) 
+    { d->osd_ypar[i>>6] |= (uint64_t)1 << (i&63);
+    }
+    d->osd_pcost[i] = osd_cost(lratio[j]);
+  }
+
+  icost = 0;
+  for (t = 0; t<K; t++)
+  { j = info[t];
+    c = osd_cost(lratio[j]);
+    if (dblk[j] != (lratio[j]>1))
+    { icost += c;
+      d->osd_icost[t] = -c;
+    }
+    else
+    { d->osd_icost[t] = c;
+    }
+    if (dblk[j])
+    { for (k = 0; k<W; k++)
+      { par[k] ^= g[t*W+k];
+      }
+    }
+  }
+
+  /* Search for the best codeword, and store it in dblk. */
+
+  d->osd_best_cost = HUGE_VAL;
+  d->osd_nbest = 0;
+
+  osd_search (d, 0, 0, icost);
+
+  for (k = 0; k<d->osd_nbest; k++)
+  { t = d->osd_best[k];
+    for (i = 0; i<W; i++)
+    { par[i] ^= g[t*W+i];
+    }
+    dblk[info[t]] ^= 1;
+  }
+
+  for (i = 0; i<r; i++)
+  { dblk[perm[cols[i]]] = (par[i>>6] >> (i&63)) & 1;
+  }
+}
+
+
+/* DECODE USING THE MIN-SUM ALGORITHM.  Decodes using min-sum (also called
+   max-product) message passing, in which all messages are logs of ratios 
+   of probabilities for a bit being 0 versus 1, and the message from a check 
+   to a bit is found from only the signs and the smallest magnitudes of the
+   messages to that check from the other bits.  No divisions or transcendental
+   functions are needed.  The magnitude of each message from a check is 
+   multiplied by ms_scale (normalized min-sum), and then has ms_offset 
+   subtracted (offset min-sum), with negative results set to zero.  Plain
+   min-sum has ms_scale of one and ms_offset of zero.
+
+   The iterations are stopped as for prprp_decode, and the values stored in 
+   dblk, pchk, and bprb, and the value returned, are as for prprp_decode.
+   The same procedure is used for the Prprp_llr method, which differs only
+   in how an iteration is done (see iterllr below).
+
+   The setup procedure below finds the Tanner graph, allocates space for 
+   the messages and finds the order of rows used by iterms (using the 
+   procedure immediately below, which is also used for Cascade), and 
+   outputs headers for the detailed trace file, if required.
+*/
+
+static void minsum_space
+( ldpc_decoder *d	/* Decoder, with its Tanner graph */
+)
+{
+  tanner_graph *G;
+
+  G = d->graph;
+
+  d->ms_c2v = chk_alloc (tanner_edges(G), sizeof *d->ms_c2v);
+  d->ms_ch  = chk_alloc (tanner_cols(G), sizeof *d->ms_ch);
+  d->ms_tot = chk_alloc (tanner_cols(G), sizeof *d->ms_tot);
+  d->ms_new = chk_alloc (tanner_cols(G), sizeof *d->ms_new);
+  d->ms_v2c = chk_alloc (max_row_degree(G), sizeof *d->ms_v2c);
+
+  if (d->kern_rows==0)	/* Cascade may have set this up already */
+  { kern_setup(d);
+  }
+}
+
+void minsum_decode_setup 
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  graph_setup(d);
+  minsum_space(d);
+
+  if (d->table==2)
+  { trace_header();
+  }
+}
+
+unsigned minsum_decode
+( ldpc_decoder *d,	/* Decoder to use */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb		/* Place to store bit probabilities */
+)
+{ 
+  int n, c;
+
+  initms(d,lratio,dblk);
+
+  for (n = 0; ; n++)
+  { 
+    c = check_packed(d->code->packed,dblk,pchk,d->chk_words);
+
+    if (d->table==2)
+    { msbitpr(d,bprb);
+      trace_iter(d,n,c,lratio,dblk,bprb);
+    }
+   
+    if (n==d->max_iter || n==-d->max_iter || (d->max_iter>0 && c==0))
+    { break; 
+    }
+
+    if (d->dl_end>0 && dec_clock()>=d->dl_end)
+    { d->late = 1;
+      break;
+    }
+
+    if (d->method==Prprp_llr)
+    { iterllr(d,dblk);
+    }
+    else
+    { iterms(d,dblk);
+    }
+  }
+
+  msbitpr(d,bprb);
+
+  return n;
+}
+
+
+/* INITIALIZE MIN-SUM DECODING.  Finds the log ratios from the received data
+   (limited in magnitude, so that infinite likelihood ratios do no harm), 
+   sets all check-to-bit messages to zero, and finds the initial guess. */
+
+#define Ms_limit 1000.0		/* Limit on magnitude of log ratios */
+
+void initms
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk		/* Place to store decoding */
+)
+{
+  tanner_graph *G;
+  double l;
+  int j, k;
+
+  G = d->graph;
+
+  for (j = 0; j<tanner_cols(G); j++)
+  { l = -log(lratio[j]);
+    if (l>Ms_limit)  l = Ms_limit;
+    if (l<-Ms_limit) l = -Ms_limit;
+    d->ms_ch[j] = d->ms_tot[j] = l;
+    dblk[j] = lratio[j]>=1;
+  }
+
+  for (k = 0; k<tanner_edges(G); k++)
+  { d->ms_c2v[k] = 0;
+  }
+}
+
+
+/* DO ONE ITERATION OF MIN-SUM DECODING.  Each row is processed in turn, with
+   the message from a bit to the check found by subtracting the previous
+   message from the check from the bit's total.  The new totals for the 
+   bits are then found a column at a time, using the column-to-edge index 
+   of the Tanner graph.
+
+   As in iterprp, the rows are done in the order found by kern_setup, and 
+   each run of Batch_vec rows with the same degree is done together (by 
+   ms_rows), so that the work for different rows can overlap, rather than
+   waiting on the comparisons for one row at a time.  The new messages are
+   added into the totals in order of row, whatever order the rows were done
+   in, so the results are the same either way. */
+
+void iterms
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  char *dblk		/* Place to store decoding */
+)
+{
+  tanner_graph *G;
+  double *ms_c2v, *ms_ch, *ms_tot, *ms_new, *ms_v2c;
+  double ms_scale, ms_offset;
+  double min1, min2, v, m, sg;
+  int *ec, *rows, *cs, *ce;
+  int M, N;
+  int i, j, e, a, b, p, w, emin, neg;
+
+  G = d->graph;
+  M = tanner_rows(G);
+  N = tanner_cols(G);
+  ec = G->edge_col;
+
+  ms_c2v = d->ms_c2v;
+  ms_ch  = d->ms_ch;
+  ms_tot = d->ms_tot;
+  ms_new = d->ms_new;
+  ms_v2c = d->ms_v2c;
+
+  ms_scale = d->ms_scale;
+  ms_offset = d->ms_offset;
+  rows = d->kern_rows;
+  cs = G->col_start;
+  ce = G->col_edge;
+
+  for (p = 0; p<M; p++)
+  { 
+    i = rows[p];
+    w = tanner_row_degree(G,i);
+    if (w>=2 && p+Batch_vec<=M && w<=Kern_max 
+         && tanner_row_degree(G,rows[p+Batch_vec-1])==w)
+    { ms_rows(d,rows+p,w);
+      p += Batch_vec-1;
+      continue;
+    }
+
+    a = G->row_start[i];
+    b = G->row_start[i+1];
+
+    /* A check with only one bit says for certain that it is zero, as in
+       iterllr.  (Otherwise the second smallest magnitude below would be 
+       infinite, and later give infinity minus infinity.) */
+
+    if (b-a<2) 
+    { if (b>a) 
+      { ms_c2v[a] = Ms_limit;
+      }
+      continue;
+    }
+
+    /* Find the two smallest magnitudes of messages from bits, and the 
+       parity of their signs.  The messages from bits are saved in ms_v2c.
+       This is written to avoid data-dependent branches, which would
+       otherwise dominate the time taken. */
+
+    min1 = min2 = HUGE_VAL;
+    emin = a;
+    neg = 0;
+
+    for (e = a; e<b; e++)
+    { v = ms_tot[ec[e]] - ms_c2v[e];
+      ms_v2c[e-a] = v;
+      neg ^= v<0;
+      v = fabs(v);
+      m = v>min1 ? v : min1;
+      min2 = m<min2 ? m : min2;
+      emin = v<min1 ? e : emin;
+      min1 = v<min1 ? v : min1;
+    }
+
+    /* Find the new messages to bits. */
+
+    min1 = ms_scale*min1 - ms_offset;
+    min2 = ms_scale*min2 - ms_offset;
+    if (min1<0) min1 = 0;
+    if (min2<0) min2 = 0;
+
+    sg = neg ? -1.0 : 1.0;
+
+    for (e = a; e<b; e++)
+    { m = e==emin ? min2 : min1;
+      ms_c2v[e] = sg * copysign(m,ms_v2c[e-a]);
+    }
+  }
+
+  /* Find the new totals, and the next guess. */
+
+  for (j = 0; j<N; j++)
+  { v = ms_ch[j];
+    for (e = cs[j]; e<cs[j+1]; e++)
+    { v += ms_c2v[ce[e]];
+    }
+    ms_new[j] = v;
+    dblk[j] = v<=0;
+  }
+
+  d->ms_tot = ms_new;
+  d->ms_new = ms_tot;
+}
+
+
+/* FIND MIN-SUM MESSAGES FROM BATCH_VEC CHECKS OF THE SAME DEGREE.  Done as 
+   for a single check in iterms, but with the messages for the k'th edge of
+   each check stored together, so that the innermost loops are over the 
+   checks.  Rather than the index of the edge with smallest magnitude, only
+   the magnitude is kept, and an edge whose message has that magnitude gets
+   the second smallest.  If more than one does, the two smallest are equal,
+   so the messages are the same as from iterms.  The degree must be at 
+   least two. */
+
+static void ms_rows
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  int *rows,		/* The rows to do */
+  int w			/* Degree of all these rows, at most Kern_max */
+)
+{
+  double v[Kern_max*Batch_vec];
+  double min1[Batch_vec], min2[Batch_vec];
+  int a[Batch_vec], neg[Batch_vec];
+  double *ms_c2v, *ms_tot, *c2v;
+  double s[2], t, m, sg;
+  int *ec;
+  int k, l;
+
+  ms_c2v = d->ms_c2v;
+  ms_tot = d->ms_tot;
+  ec = d->graph->edge_col;
+
+  for (l = 0; l<Batch_vec; l++)
+  { a[l] = d->graph->row_start[rows[l]];
+    min1[l] = min2[l] = HUGE_VAL;
+    neg[l] = 0;
+  }
+
+  /* Find the messages from bits, and the two smallest magnitudes and the
+     parity of the signs for each check. */
+
+  for (k = 0; k<w; k++)
+  { for (l = 0; l<Batch_vec; l++)
+    { t = ms_tot[ec[a[l]+k]] - ms_c2v[a[l]+k];
+      v[k*Batch_vec+l] = t;
+      neg[l] ^= t<0;
+      t = fabs(t);
+      m = t>min1[l] ? t : min1[l];
+      min2[l] = m<min2[l] ? m : min2[l];
+      min1[l] = t<min1[l] ? t : min1[l];
+    }
+  }
+
+  /* Find the new messages.  The new magnitude is looked up in s, indexed 
+     by whether the edge has the smallest magnitude, which avoids an 
+     unpredictable branch. */
+
+  for (l = 0; l<Batch_vec; l++)
+  { sg = neg[l] ? -1.0 : 1.0;
+    s[0] = d->ms_scale*min1[l] - d->ms_offset;
+    s[1] = d->ms_scale*min2[l] - d->ms_offset;
+    if (s[0]<0) s[0] = 0;
+    if (s[1]<0) s[1] = 0;
+    c2v = ms_c2v + a[l];
+    for (k = 0; k<w; k++)
+    { t = v[k*Batch_vec+l];
+      c2v[k] = sg * copysign(s[fabs(t)==min1[l]],t);
+    }
+  }
+}
+
+
+/* FIND BIT PROBABILITIES FROM MIN-SUM TOTALS. */
+
+void msbitpr
+( ldpc_decoder *d,	/* Decoder, with totals from decoding */
+  double *bprb		/* Place to store bit probabilities, 0 if not wanted */
+)
+{
+  int j;
+
+  if (bprb==0) return;
+
+  for (j = 0; j<tanner_cols(d->graph); j++)
+  { bprb[j] = 1/(1+exp(d->ms_tot[j]));
+  }
+}
+
+
+/* DECODE BY PROBABILITY PROPAGATION USING LOG RATIOS.  Does the same 
+   computation as prprp_decode with the flooding schedule, but with all
+   messages being log ratios, as for minsum_decode, which is used for the
+   decoding (with iterllr in place of iterms).  The message from a check 
+   to a bit is found from the messages from the check's other bits using
+   the function
+
+      phi(x)  =  log ((exp(x)+1) / (exp(x)-1))
+
+   which is its own inverse.  The magnitude of the message is phi of the
+   sum of phi(|m|) for the messages, m, from the other bits, and its sign
+   is the product of their signs.  Since phi(|m|) is found once for each
+   bit and summed, the messages for all bits of a check are found with one
+   sum over the check, subtracting the bit's own term for each message.
+
+   For x of at least 1/Llr_steps, phi(x) is taken from the nearest entry
+   in a table (llr_tab) with Llr_steps entries per unit of x, up to Llr_max,
+   beyond which it is taken to be zero.  Interpolating between entries
+   would be more accurate, but makes each iteration slower than iterprp.
+   Smaller x, where phi(x) is large and changes rapidly, is done with the
+   formula above (limited to Ms_limit) for messages from bits, and as 
+   described for iterllr for messages from checks.  The error is less than
+   0.002 for x above one, and less than 0.01 for x above 1/4, so the 
+   results usually match those of prprp_decode closely, but not exactly.
+   No divisions are needed, and since the log ratios are limited in 
+   magnitude by initms, the messages can never be infinite or NaN.
+
+   The setup procedure below finds the Tanner graph, allocates space for 
+   the messages (as for minsum_decode), fills in the table, and outputs 
+   headers for the detailed trace file, if required.
+*/
+
+#define Llr_steps 256		/* Table entries per unit of log ratio */
+#define Llr_max 16		/* Size of table, in units of log ratio */
+
+void llr_decode_setup 
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  int i;
+
+  graph_setup(d);
+  minsum_space(d);
+
+  d->llr_tab = chk_alloc (Llr_max*Llr_steps+1, sizeof *d->llr_tab);
+  d->llr_tab[0] = Ms_limit;
+  for (i = 1; i<Llr_max*Llr_steps; i++)
+  { d->llr_tab[i] = llr_phi((double)i/Llr_steps);
+  }
+  d->llr_tab[Llr_max*Llr_steps] = 0;
+  d->llr_ph = chk_alloc (max_row_degree(d->graph), sizeof *d->llr_ph);
+
+  if (d->table==2)
+  { trace_header();
+  }
+}
+
+
+/* FIND PHI(X) FROM ITS FORMULA.  X must not be negative. */
+
+static double llr_phi
+( double x		/* Point to find it at */
+)
+{
+  double t;
+
+  t = log1p(2/expm1(x));
+
+  return t<Ms_limit ? t : Ms_limit;
+}
+
+
+/* FIND PHI(X) FROM THE TABLE, using the nearest entry.  X must not be 
+   negative.  This is a macro so that it is done in line, since it is in 
+   the innermost loops; i is set to the index of the entry used. */
+
+#define LLR_LOOKUP(tab,x,i) \
+  ( (i) = (int) ((x)*Llr_steps + 0.5), \
+    (tab)[(i)<Llr_max*Llr_steps ? (i) : Llr_max*Llr_steps] )
+
+
+/* DO ONE ITERATION OF PROBABILITY PROPAGATION USING LOG RATIOS.  Done in 
+   the same way as iterms, except for how the messages from a check are
+   found from the messages from its bits, with runs of Batch_vec checks of
+   the same degree done together by llr_rows, and others as below.  The 
+   new totals for bits are then found from the messages from their checks,
+   in order of check.
+
+   When the sum of phi for a check's other bits is less than 1/Llr_steps,
+   so that the message would have magnitude greater than phi(1/Llr_steps),
+   which is about 6.2, the smallest magnitude from the other bits is used 
+   instead.  This is what the message would be if the other bits' 
+   magnitudes differed greatly, and is never less than the exact value, nor
+   greater by more than the log of the number of other bits.  Such messages
+   are common once the decoding has settled, and this avoids computing phi
+   from its formula for them. */
+
+void iterllr
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  char *dblk		/* Place to store decoding */
+)
+{
+  tanner_graph *G;
+  double *ms_c2v, *ms_tot, *ms_new, *ms_v2c, *llr_ph, *tab;
+  double s, sg, t, v, min1, min2;
+  int *ec, *cs, *ce, *rows;
+  int M, N;
+  int i, j, k, e, a, b, p, w, neg;
+
+  G = d->graph;
+  M = tanner_rows(G);
+  N = tanner_cols(G);
+  ec = G->edge_col;
+  cs = G->col_start;
+  ce = G->col_edge;
+
+  ms_c2v = d->ms_c2v;
+  ms_tot = d->ms_tot;
+  ms_new = d->ms_new;
+  ms_v2c = d->ms_v2c;
+  llr_ph = d->llr_ph;
+  tab = d->llr_tab;
+  rows = d->kern_rows;
+
+  for (p = 0; p<M; p++)
+  { 
+    i = rows[p];
+    w = tanner_row_degree(G,i);
+    if (w>=2 && p+Batch_vec<=M && w<=Kern_max 
+         && tanner_row_degree(G,rows[p+Batch_vec-1])==w)
+    { llr_rows(d,rows+p,w);
+      p += Batch_vec-1;
+      continue;
+    }
+
+    a = G->row_start[i];
+    b = G->row_start[i+1];
+
+    /* A check with only one bit says for certain that it is zero. */
+
+    if (b-a<2) 
+    { if (b>a) 
+      { ms_c2v[a] = Ms_limit;
+      }
+      continue;
+    }
+
+    /* Find the messages from bits, the sum of phi of their magnitudes, the
+       two smallest magnitudes, and the parity of their signs. */
+
+    s = 0;
+    neg = 0;
+    min1 = min2 = Ms_limit;
+    for (e = a; e<b; e++)
+    { t = ms_tot[ec[e]] - ms_c2v[e];
+      ms_v2c[e-a] = t;
+      neg ^= t<0;
+      v = fabs(t);
+      llr_ph[e-a] = v<1.0/Llr_steps ? llr_phi(v) : LLR_LOOKUP(tab,v,k);
+      s += llr_ph[e-a];
+      if (v<min1) 
+      { min2 = min1;
+        min1 = v;
+      }
+      else if (v<min2)
+      { min2 = v;
+      }
+    }
+    sg = neg ? -1 : 1;
+
+    /* Find the messages to bits, leaving out each bit's own term. */
+
+    for (e = a; e<b; e++)
+    { t = s - llr_ph[e-a];
+      if (t<1.0/Llr_steps)
+      { v = fabs(ms_v2c[e-a])==min1 ? min2 : min1;
+      }
+      else
+      { v = LLR_LOOKUP(tab,t,k);
+      }
+      ms_c2v[e] = sg * copysign(v,ms_v2c[e-a]);
+    }
+  }
+
+  /* Find the new totals for bits, and the next guess. */
+
+  for (j = 0; j<N; j++)
+  { v = d->ms_ch[j];
+    for (e = cs[j]; e<cs[j+1]; e++)
+    { v += ms_c2v[ce[e]];
+    }
+    ms_new[j] = v;
+    dblk[j] = v<=0;
+  }
+
+  d->ms_tot = ms_new;
+  d->ms_new = ms_tot;
+}
+
+
+/* FIND MESSAGES FROM BATCH_VEC CHECKS OF THE SAME DEGREE USING LOG RATIOS.
+   Done as for a single check in iterllr, but with the messages for the 
+   k'th edge of each check stored together, so that the innermost loops 
+   are over the checks, and with the two smallest magnitudes found as in
+   ms_rows.  The choice between the table and the smallest magnitude is 
+   made by indexing, to avoid an unpredictable branch.  The degree must be
+   at least two. */
+
+static void llr_rows
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  int *rows,		/* The rows to do */
+  int w			/* Degree of all these rows, at most Kern_max */
+)
+{
+  double v[Kern_max*Batch_vec], ph[Kern_max*Batch_vec];
+  double s[Batch_vec], min1[Batch_vec], min2[Batch_vec];
+  int a[Batch_vec], neg[Batch_vec];
+  double *ms_c2v, *ms_tot, *tab, *c2v;
+  double c[3], t, m, sg;
+  int *ec;
+  int i, k, l;
+
+  ms_c2v = d->ms_c2v;
+  ms_tot = d->ms_tot;
+  tab = d->llr_tab;
+  ec = d->graph->edge_col;
+
+  for (l = 0; l<Batch_vec; l++)
+  { a[l] = d->graph->row_start[rows[l]];
+    min1[l] = min2[l] = Ms_limit;
+    s[l] = 0;
+    neg[l] = 0;
+  }
+
+  /* Find the messages from bits, the sums of phi, the two smallest
+     magnitudes and the parity of the signs for each check. */
+
+  for (k = 0; k<w; k++)
+  { for (l = 0; l<Batch_vec; l++)
+    { t = ms_tot[ec[a[l]+k]] - ms_c2v[a[l]+k];
+      v[k*Batch_vec+l] = t;
+      neg[l] ^= t<0;
+      t = fabs(t);
+      if (t<1.0/Llr_steps)
+      { m = llr_phi(t);
+      }
+      else
+      { m = LLR_LOOKUP(tab,t,i);
+      }
+      ph[k*Batch_vec+l] = m;
+      s[l] += m;
+      m = t>min1[l] ? t : min1[l];
+      min2[l] = m<min2[l] ? m : min2[l];
+      min1[l] = t<min1[l] ? t : min1[l];
+    }
+  }
+
+  /* Find the new messages. */
+
+  for (l = 0; l<Batch_vec; l++)
+  { sg = neg[l] ? -1.0 : 1.0;
+    c2v = ms_c2v + a[l];
+    for (k = 0; k<w; k++)
+    { t = s[l] - ph[k*Batch_vec+l];
+      m = v[k*Batch_vec+l];
+      c[0] = LLR_LOOKUP(tab,t,i);
+      c[1] = min1[l];
+      c[2] = min2[l];
+      c2v[k] = sg * copysign(c[(t<1.0/Llr_steps)*(1+(fabs(m)<=min1[l]))],m);
+    }
+  }
+}
+
+
+/* DECODE USING FIXED-POINT MIN-SUM.  Decodes as for minsum_decode, but with
+   log ratios quantized to integer multiples of fx_step, and messages from 
+   checks stored as integers of fx_bits bits (signed chars if fx_bits is no 
+   more than 8, shorts otherwise), saturated to the largest magnitude that
+   fits.  The magnitudes of messages from checks are normalized by a factor
+   of 3/4, rounded to the nearest integer.  The totals for bits are kept as
+   ints, and so are not saturated.  This mimics a hardware decoder, and 
+   reduces the memory needed for messages by a factor of eight (or four)
+   compared to prprp.
+
+   The iterations are stopped as for prprp_decode, and the values stored in 
+   dblk, pchk, and bprb, and the value returned, are as for prprp_decode.
+*/
+
+void fixed_decode_setup 
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  tanner_graph *G;
+
+  graph_setup(d);
+  G = d->graph;
+
+  d->fx_max = (1<<(d->fx_bits-1)) - 1;
+
+  if (d->fx_bits<=8)
+  { d->fx_c2v8 = chk_alloc (tanner_edges(G), sizeof *d->fx_c2v8);
+  }
+  else
+  { d->fx_c2v16 = chk_alloc (tanner_edges(G), sizeof *d->fx_c2v16);
+  }
+
+  d->fx_ch  = chk_alloc (tanner_cols(G), sizeof *d->fx_ch);
+  d->fx_chd = chk_alloc (tanner_cols(G), sizeof *d->fx_chd);
+  d->fx_tot = chk_alloc (tanner_cols(G), sizeof *d->fx_tot);
+  d->fx_new = chk_alloc (tanner_cols(G), sizeof *d->fx_new);
+  d->fx_v2c = chk_alloc (max_row_degree(G), sizeof *d->fx_v2c);
+
+  if (d->table==2)
+  { trace_header();
+  }
+}
+
+unsigned fixed_decode
+( ldpc_decoder *d,	/* Decoder to use */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb		/* Place to store bit probabilities */
+)
+{ 
+  int n, c;
+
+  initfx(d,lratio,dblk);
+
+  for (n = 0; ; n++)
+  { 
+    c = check_packed(d->code->packed,dblk,pchk,d->chk_words);
+
+    if (d->table==2)
+    { fxbitpr(d,bprb);
+      trace_iter(d,n,c,lratio,dblk,bprb);
+    }
+   
+    if (n==d->max_iter || n==-d->max_iter || (d->max_iter>0 && c==0))
+    { break; 
+    }
+
+    if (d->fx_bits<=8)
+    { iterfx8(d,dblk);
+    }
+    else
+    { iterfx16(d,dblk);
+    }
+  }
 
-/* DECODE BY EXHAUSTIVE ENUMERATION.  Decodes by trying all possible source
-   messages (and hence all possible codewords, unless the parity check matrix
-   was redundant).  If the last argument is 1, it sets dblk to the most likely
-   entire block; if this argument is 0, each bit of dblk is set to the most
-   likely value for that bit.  The marginal probabilities of each bit being 1
-   are returned in bitpr.
+  fxbitpr(d,bprb);
 
-   The function value returned is the total number of codewords tried (which 
-   will be the same for all blocks).  The return valued is "unsigned" because
-   it might conceivably be as big as 2^31.
+  return n;
+}
 
-   The parity check matrix and other data are taken from the global variables
-   declared in rcode.h.
 
-   The number of message bits should not be greater than 31 for this procedure.
-   The setup procedure immediately below checks this, reads the generator file,
-   and outputs headers for the detailed trace file, if required.
- */
+/* INITIALIZE FIXED-POINT DECODING.  Quantizes the log ratios from the data
+   (rounding to the nearest multiple of fx_step, and saturating), sets all 
+   messages from checks to zero, and finds the initial guess.  A bit whose
+   total log ratio is zero is decoded as it would be from the unquantized 
+   data (as in initprp), which is saved in fx_chd for later iterations, so 
+   that small log ratios that are rounded to zero don't all decode as 1. */
 
-void enum_decode_setup(void)
+void initfx
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk		/* Place to store decoding */
+)
 {
-  read_gen(gen_file,0,0);
+  tanner_graph *G;
+  double l;
+  int fx_max;
+  int j, k;
 
-  if (N-M>31)
-  { fprintf(stderr,
-"Trying to decode messages with %d bits by exhaustive enumeration is absurd!\n",
-      N-M);
-    exit(1);  
+  G = d->graph;
+  fx_max = d->fx_max;
+
+  for (j = 0; j<tanner_cols(G); j++)
+  { l = -log(lratio[j]) / d->fx_step;
+    d->fx_ch[j] = l>fx_max ? fx_max : l<-fx_max ? -fx_max 
+                : (int) floor(l+0.5);
+    d->fx_tot[j] = d->fx_ch[j];
+    d->fx_chd[j] = lratio[j]>=1;
+    dblk[j] = d->fx_tot[j]==0 ? d->fx_chd[j] : d->fx_tot[j]<0;
   }
 
-  if (table==2)
-  { printf("  block   decoding  likelihood\n");
+  for (k = 0; k<tanner_edges(G); k++)
+  { if (d->fx_bits<=8) d->fx_c2v8[k] = 0;
+    else               d->fx_c2v16[k] = 0;
   }
 }
 
-unsigned enum_decode
-( double *lratio,	/* Likelihood ratios for bits */
-  char *dblk, 		/* Place to stored decoded message */
-  double *bitpr,	/* Place to store marginal bit probabilities */
-  int max_block		/* Maximize probability of whole block being correct? */
+
+/* DO ONE ITERATION OF FIXED-POINT MIN-SUM DECODING.  The procedures for
+   8-bit and 16-bit messages are identical apart from the type of the
+   messages, so they are both defined using the macro below.  Apart from
+   the arithmetic, they work as iterms does. */
+
+#define FIXED_ITER(name,type,field) \
+void name \
+( ldpc_decoder *d,	/* Decoder, with Tanner graph and space for messages */ \
+  char *dblk		/* Place to store decoding */ \
+) \
+{ \
+  tanner_graph *G; \
+  type *c2v; \
+  int *fx_ch, *fx_tot, *fx_new, *fx_v2c; \
+  int min1, min2, v, m, neg, fx_max; \
+  int *ec; \
+  int i, j, e, a, b, emin; \
+\
+  G = d->graph; \
+  ec = G->edge_col; \
+\
+  c2v = d->field; \
+  fx_ch = d->fx_ch; \
+  fx_tot = d->fx_tot; \
+  fx_new = d->fx_new; \
+  fx_v2c = d->fx_v2c; \
+  fx_max = d->fx_max; \
+\
+  for (j = 0; j<tanner_cols(G); j++) \
+  { fx_new[j] = fx_ch[j]; \
+  } \
+\
+  for (i = 0; i<tanner_rows(G); i++) \
+  { \
+    a = G->row_start[i]; \
+    b = G->row_start[i+1]; \
+\
+    min1 = min2 = fx_max; \
+    emin = a; \
+    neg = 0; \
+\
+    for (e = a; e<b; e++) \
+    { v = fx_tot[ec[e]] - c2v[e]; \
+      v = v>fx_max ? fx_max : v<-fx_max ? -fx_max : v; \
+      fx_v2c[e-a] = v; \
+      neg ^= v<0; \
+      v = v<0 ? -v : v; \
+      m = v>min1 ? v : min1; \
+      min2 = m<min2 ? m : min2; \
+      emin = v<min1 ? e : emin; \
+      min1 = v<min1 ? v : min1; \
+    } \
+\
+    min1 = (3*min1+2) >> 2; \
+    min2 = (3*min2+2) >> 2; \
+\
+    for (e = a; e<b; e++) \
+    { m = e==emin ? min2 : min1; \
+      c2v[e] = v = (fx_v2c[e-a]<0) != neg ? -m : m; \
+      fx_new[ec[e]] += v; \
+    } \
+  } \
+\
+  d->fx_tot = fx_new; \
+  d->fx_new = fx_tot; \
+\
+  for (j = 0; j<tanner_cols(G); j++) \
+  { dblk[j] = fx_new[j]==0 ? d->fx_chd[j] : fx_new[j]<0; \
+  } \
+}
+
+FIXED_ITER(iterfx8,signed char,fx_c2v8)
+FIXED_ITER(iterfx16,short,fx_c2v16)
+
+
+/* FIND BIT PROBABILITIES FROM FIXED-POINT TOTALS. */
+
+void fxbitpr
+( ldpc_decoder *d,	/* Decoder, with totals from decoding */
+  double *bprb		/* Place to store bit probabilities, 0 if not wanted */
 )
 {
-  mod2dense *u, *v;
-  double lk, maxlk, tpr;
-  double *bpr, *lk0, *lk1;
-  char sblk[31];
-  char *cblk;
-  unsigned d;
-  int i, j;
+  int j;
 
-  if (N-M>31) abort();
+  if (bprb==0) return;
 
-  /* Allocate needed space. */
+  for (j = 0; j<tanner_cols(d->graph); j++)
+  { bprb[j] = 1/(1+exp(d->fx_step*d->fx_tot[j]));
+  }
+}
 
-  bpr = bitpr;
-  if (bpr==0 && max_block==0)
-  { bpr = chk_alloc (N, sizeof *bpr);
+
+/* DECODE BY A CASCADE OF MIN-SUM AND PROBABILITY PROPAGATION.  Tries up to
+   casc_iter iterations of min-sum decoding first (with ms_scale and 
+   ms_offset as for minsum_decode), stopping as soon as the decoding is a 
+   valid codeword.  If casc_wbf is set, weighted bit flipping, with up to
+   casc_iter flips, is tried first instead (see wbf_decode below).  If no 
+   codeword is found, the block is decoded again from the start by 
+   prprp_decode, with the schedule and max_iter set for the decoder.  Since
+   most blocks are usually decoded in a few iterations, and iterations of 
+   min-sum are cheaper, the average time per block should be less than for
+   prprp alone, with nearly the same error rate.
+
+   The values stored in dblk, pchk, and bprb are those from the stage that
+   was last done, which is recorded in casc_stage (1 for min-sum, 2 for
+   probability propagation).  The value returned is the total number of 
+   iterations of both stages.
+
+   The setup procedure sets up for both stages, with a single detailed 
+   trace, in which iterations are numbered from zero for each stage.
+*/
+
+void cascade_decode_setup
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  prprp_decode_setup(d);
+  if (d->casc_wbf)
+  { wbf_space(d);
+  }
+  else
+  { minsum_space(d);
   }
+}
 
-  cblk = chk_alloc (N, sizeof *cblk);
+unsigned cascade_decode
+( ldpc_decoder *d,	/* Decoder to use */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb		/* Place to store bit probabilities */
+)
+{ 
+  int n, c, j;
+
+  if (d->casc_wbf)
+  { n = wbf_run(d,lratio,dblk,d->casc_iter);
+    c = d->wbf_unsat;
+    if (c==0)
+    { memcpy (pchk, d->wbf_syn, tanner_rows(d->graph));
+      if (bprb)
+      { for (j = 0; j<tanner_cols(d->graph); j++)
+        { bprb[j] = dblk[j];
+        }
+      }
+    }
+  }
+  else
+  { initms(d,lratio,dblk);
+    for (n = 0; ; n++)
+    { 
+      c = check_packed(d->code->packed,dblk,pchk,d->chk_words);
+
+      if (d->table==2)
+      { msbitpr(d,bprb);
+        trace_iter(d,n,c,lratio,dblk,bprb);
+      }
+
+      if (n==d->casc_iter || c==0)
+      { break; 
+      }
 
-  if (type=='d')
-  { u = mod2dense_allocate(N-M,1);
-    v = mod2dense_allocate(M,1);
+      iterms(d,dblk);
+    }
+    if (c==0)
+    { msbitpr(d,bprb);
+    }
   }
 
-  if (type=='m')
-  { u = mod2dense_allocate(M,1);
-    v = mod2dense_allocate(M,1);
+  if (c==0)
+  { d->casc_stage = 1;
+    return n;
   }
 
-  lk0 = chk_alloc (N, sizeof *lk0);
-  lk1 = chk_alloc (N, sizeof *lk1);
+  d->casc_stage = 2;
+  return n + prprp_decode(d,lratio,dblk,pchk,bprb);
+}
+
 
-  /* Pre-compute likelihoods for bits. */
+/* DECODE WITH GALLAGER'S HARD-DECISION ALGORITHM B.  Meant for data from a
+   BSC, for which only the bits received matter (taken to be 1 where lratio
+   is greater than one).  Each bit sends the bit received to each of its 
+   checks, except that it sends the opposite if more than half the other 
+   checks for the bit sent it the opposite in the previous iteration.  Each
+   check sends each of its bits the parity of the messages from its other 
+   bits.  The decoding for a bit is the bit received, unless more than half
+   of the messages from its checks and the bit received, together, are the
+   opposite.  (For bits in three checks, this is Gallager's algorithm A.)
 
-  for (j = 0; j<N; j++)
-  { lk0[j] = 1/(1+lratio[j]);
-    lk1[j] = 1 - lk0[j];
+   Up to 64 blocks are decoded at once, in "lanes" that are the bits of 
+   64-bit words, so that all the messages for an edge, or decodings for a
+   bit, are a single word, and the computations for all lanes are done by
+   bitwise operations.  The count of checks disagreeing with the bit 
+   received is kept as a set of words saying whether it is at least k, for
+   each k up to the number needed.
+
+   The iterations are stopped for each lane as they would be for that block
+   by itself, as for prprp_decode (the decoding for a lane is then left 
+   unchanged), and the values stored in dblk and pchk, and the iterations
+   returned, are as for prprp_decode.  The probabilities stored in bprb are
+   just the bits of the decoding.
+
+   The setup procedure immediately below finds the Tanner graph, and 
+   allocates space for the messages.
+*/
+
+void gallager_decode_setup
+( ldpc_decoder *d	/* Decoder to set up */
+)
+{
+  tanner_graph *G;
+  int j, k, dv;
+
+  graph_setup(d);
+  G = d->graph;
+
+  dv = 0;
+  for (j = 0; j<tanner_cols(G); j++)
+  { if (tanner_col_degree(G,j)>dv) dv = tanner_col_degree(G,j);
   }
 
-  /* Initialize marginal bit probabilities. */
+  d->gb_v2c = chk_alloc (tanner_edges(G), sizeof *d->gb_v2c);
+  d->gb_chk = chk_alloc (tanner_rows(G), sizeof *d->gb_chk);
+  d->gb_y   = chk_alloc (tanner_cols(G), sizeof *d->gb_y);
+  d->gb_x   = chk_alloc (tanner_cols(G), sizeof *d->gb_x);
+  d->gb_ge  = chk_alloc (dv+3, sizeof *d->gb_ge);
+  d->gb_dis = chk_alloc (dv+1, sizeof *d->gb_dis);
 
-  if (bpr)
-  { for (j = 0; j<N; j++) bpr[j] = 0.0;
+  /* Messages are stored in column order, with the row for each, and the 
+     place for each edge in row order, found here. */
+
+  d->gb_row = chk_alloc (tanner_edges(G), sizeof *d->gb_row);
+  d->gb_pos = chk_alloc (tanner_edges(G), sizeof *d->gb_pos);
+
+  for (k = 0; k<tanner_edges(G); k++)
+  { d->gb_row[k] = G->edge_row[G->col_edge[k]];
+    d->gb_pos[G->col_edge[k]] = k;
   }
+}
+
+unsigned gallager_decode
+( ldpc_decoder *d,	/* Decoder to use */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb		/* Place to store bit probabilities */
+)
+{
+  unsigned n;
 
-  /* Exhaustively try all possible decoded messages. */
+  gallager_decode_batch (d, 1, &lratio, &dblk, &pchk, &bprb, &n);
 
-  tpr = 0.0;
+  return n;
+}
 
-  for (d = 0; d<=(1<<(N-M))-1; d++)
-  {
-    /* Unpack message into source block. */
 
-    for (i = N-M-1; i>=0; i--)
-    { sblk[i] = (d>>i)&1;
+/* FIND THE PARITY CHECKS FOR THE DECODINGS IN ALL LANES.  Stores the checks
+   in gb_chk, and returns the lanes in which some check is not satisfied. */
+
+static uint64_t gallager_checks
+( ldpc_decoder *d	/* Decoder, with the decodings in gb_x */
+)
+{
+  tanner_graph *G;
+  uint64_t s, unsat;
+  int i, e;
+
+  G = d->graph;
+  unsat = 0;
+
+  for (i = 0; i<tanner_rows(G); i++)
+  { s = 0;
+    for (e = G->row_start[i]; e<G->row_start[i+1]; e++)
+    { s ^= d->gb_x[G->edge_col[e]];
     }
+    d->gb_chk[i] = s;
+    unsat |= s;
+  }
 
-    /* Find full codeword for this message. */
+  return unsat;
+}
 
-    switch (type)
-    { case 's':
-      { sparse_encode (sblk, cblk);
-        break;
-      }
-      case 'd':
-      { dense_encode (sblk, cblk, u, v);
-        break;
+
+/* FIND LANES WHERE A COUNT IS AT LEAST SOME VALUE.  The count is given by
+   its four bits, c0 (low order) to c3, for each lane, and is compared with
+   m = v-1 going from the high-order bit down, keeping track of lanes where
+   the count is greater than m, and lanes where it is equal so far. */
+
+static uint64_t gallager_at_least
+( uint64_t c0, uint64_t c1, uint64_t c2, uint64_t c3,  /* Bits of count */
+  int v			/* Value to compare with */
+)
+{
+  uint64_t gt, eq;
+  int m;
+
+  m = v-1;
+  gt = 0;
+  eq = ~(uint64_t)0;
+
+  if (m>>3 & 1) eq &= c3; else { gt |= eq & c3; eq &= ~c3; }
+  if (m>>2 & 1) eq &= c2; else { gt |= eq & c2; eq &= ~c2; }
+  if (m>>1 & 1) eq &= c1; else { gt |= eq & c1; eq &= ~c1; }
+  if (m & 1)    eq &= c0; else { gt |= eq & c0; }
+
+  return gt;
+}
+
+
+/* DECODE A BATCH OF BLOCKS WITH ALGORITHM B.  Decodes up to 64 blocks at 
+   once, one in each lane, with results as described above.  For bits in
+   fewer than 16 checks, the number of disagreeing checks is kept as a 
+   four-bit count for each lane, in four local variables, which can be kept
+   in registers, and is then compared with the thresholds.  For other bits,
+   ge[k] is found for each k up to the largest threshold. */
+
+void gallager_decode_batch
+( ldpc_decoder *d,	/* Decoder to use */
+  int nb,		/* Number of blocks to decode, at most 64 */
+  double **lratio,	/* Likelihood ratios for bits, for each block */
+  char **dblk,		/* Places to store decodings */
+  char **pchk,		/* Places to store parity checks */
+  double **bprb,	/* Places to store bit probabilities */
+  unsigned *iters	/* Places to store number of iterations */
+)
+{
+  tanner_graph *G;
+  uint64_t *v2c, *chk, *ge, *dis, *x;
+  int *row, *pos;
+  uint64_t c0, c1, c2, c3;
+  uint64_t active, done, y, s;
+  int M, N, n, i, j, k, e, l, dv, b, t, L;
+
+  G = d->graph;
+  M = tanner_rows(G);
+  N = tanner_cols(G);
+
+  v2c = d->gb_v2c;
+  chk = d->gb_chk;
+  ge = d->gb_ge;
+  dis = d->gb_dis;
+  x = d->gb_x;
+  row = d->gb_row;
+  pos = d->gb_pos;
+
+  if (nb<1 || nb>64) abort();
+
+  active = nb==64 ? ~(uint64_t)0 : ((uint64_t)1<<nb) - 1;
+
+  /* Pack the bits received, which are the initial decoding and messages. */
+
+  for (j = 0; j<N; j++)
+  { y = 0;
+    for (l = 0; l<nb; l++)
+    { if (lratio[l][j]>1) y |= (uint64_t)1 << l;
+    }
+    d->gb_y[j] = y;
+    x[j] = y;
+    for (k = G->col_start[j]; k<G->col_start[j+1]; k++)
+    { v2c[k] = y;
+    }
+  }
+
+  /* Do iterations until all lanes have stopped, or the maximum is reached.
+     Lanes stop only if max_iter is positive. */
+
+  for (n = 0; ; n++)
+  { 
+    if (d->max_iter>0)
+    { done = active & ~gallager_checks(d);
+      for (l = 0; l<nb; l++)
+      { if (done>>l & 1) iters[l] = n;
       }
-      case 'm':
-      { mixed_encode (sblk, cblk, u, v);
-        break;
+      active &= ~done;
+    }
+
+    if (active==0 || n==d->max_iter || n==-d->max_iter)
+    { break;
+    }
+
+    /* Find the parity of the messages for each check, from which the 
+       message to each bit is found by removing its own message. */
+
+    for (i = 0; i<M; i++)
+    { s = 0;
+      for (e = G->row_start[i]; e<G->row_start[i+1]; e++)
+      { s ^= v2c[pos[e]];
       }
+      chk[i] = s;
     }
 
-    /* Compute likelihood for this decoding. */
+    /* Count the checks disagreeing with each bit received, and find the 
+       new messages from the bit, and the new decoding.  A bit sends the
+       opposite of what was received to a check if at least b other checks
+       disagree, which is so if at least b+1 disagree in total, or b do and
+       this check agrees.  The decoding is the opposite if at least t of
+       its checks disagree. */
 
-    lk = 1;
     for (j = 0; j<N; j++)
-    { lk *= cblk[j]==0 ? lk0[j] : lk1[j];
-    }
+    { dv = tanner_col_degree(G,j);
+      b = (dv-1)/2 + 1;
+      t = (dv+1)/2 + 1;
+      L = b+1>t ? b+1 : t;
+      y = d->gb_y[j];
 
-    /* Update maximum likelihood decoding. */
+      v2c += G->col_start[j];
+      row += G->col_start[j];
 
-    if (max_block)
-    { if (d==0 || lk>maxlk)
-      { for (j = 0; j<N; j++)
-        { dblk[j] = cblk[j];
+      if (dv<16)
+      { c0 = c1 = c2 = c3 = 0;
+        for (k = 0; k<dv; k++)
+        { dis[k] = chk[row[k]] ^ v2c[k] ^ y;
+          s = c0 & dis[k]; c0 ^= dis[k];
+          c1 ^= s; s &= ~c1;
+          c2 ^= s; s &= ~c2;
+          c3 ^= s;
         }
-        maxlk = lk;
+        ge[b] = gallager_at_least(c0,c1,c2,c3,b);
+        ge[b+1] = gallager_at_least(c0,c1,c2,c3,b+1);
+        ge[t] = gallager_at_least(c0,c1,c2,c3,t);
       }
-    }
-
-    /* Update bit probabilities. */
- 
-    if (bpr)
-    { for (j = 0; j<N; j++) 
-      { if (cblk[j]==1) 
-        { bpr[j] += lk;
+      else
+      { ge[0] = ~(uint64_t)0;
+        for (l = 1; l<=L; l++) 
+        { ge[l] = 0;
+        }
+        for (k = 0; k<dv; k++)
+        { dis[k] = chk[row[k]] ^ v2c[k] ^ y;
+          for (l = L; l>0; l--) 
+          { ge[l] |= ge[l-1] & dis[k];
+          }
         }
       }
-      tpr += lk;
-    }
 
-    /* Output data to trace file. */
+      for (k = 0; k<dv; k++)
+      { v2c[k] = y ^ ((dis[k] & ge[b+1]) | (~dis[k] & ge[b]));
+      }
+
+      v2c -= G->col_start[j];
+      row -= G->col_start[j];
 
-    if (table==2)
-    { printf("%7d %10x  %10.4e\n",block_no,d,lk);
+      y ^= ge[t];
+      x[j] = (y & active) | (x[j] & ~active);
     }
   }
 
-  /* Normalize bit probabilities. */
+  /* Store the results. */
 
-  if (bpr)
-  { for (j = 0; j<N; j++) bpr[j] /= tpr;
+  for (l = 0; l<nb; l++)
+  { if (active>>l & 1) iters[l] = n;
   }
 
-  /* Decoding to maximize bit-by-bit success, if that's what's wanted. 
-     In case of a tie, decode to a 1. */
+  gallager_checks(d);
 
-  if (!max_block)
-  { for (j = 0; j<N; j++) 
-    { dblk[j] = bpr[j]>=0.5;
+  for (l = 0; l<nb; l++)
+  { for (j = 0; j<N; j++)
+    { dblk[l][j] = x[j]>>l & 1;
+      if (bprb && bprb[l]) bprb[l][j] = dblk[l][j];
+    }
+    for (i = 0; i<M; i++)
+    { pchk[l][i] = chk[i]>>l & 1;
     }
   }
+}
 
-  /* Free space. */
 
-  if (bpr!=0 && bpr!=bitpr) free(bpr);
-  free(cblk);
-  free(lk0);
-  free(lk1);
+/* DECODE BY WEIGHTED BIT FLIPPING.  Starts with the hard decisions from the
+   data, and then repeatedly flips the bit that most increases
 
-  return 1<<(N-M);
-}
+      sum over bits j of a[j] |log lratio[j]|
+        + wbf_weight * sum over checks i of (1 if satisfied, else -1)
 
+   where a[j] is 1 if bit j is the same as its hard decision and -1 if not.
+   This is the "gradient descent" form of weighted bit flipping, in which
+   the bits are weighted by their reliability, and a bit is flipped only if
+   the checks it is in outweigh its own reliability.  Flipping stops when the 
+   decoding is a valid codeword, when no flip would increase the sum above,
+   or after max_iter flips (which must be positive).
 
-/* DECODE USING PROBABILITY PROPAGATION.  Tries to find the most probable 
-   values for the bits of the codeword, given a parity check matrix (H), and
-   likelihood ratios (lratio) for each bit.  If max_iter is positive, up to 
-   that many iterations of probability propagation are done, stopping before 
-   then if the tentative decoding is a valid codeword.  If max_iter is 
-   negative, abs(max_iter) iterations are done, regardless of whether a 
-   codeword was found earlier.
+   The gain from flipping each bit is kept up to date as bits are flipped,
+   along with the parity checks, and the bits are kept in a heap ordered by
+   gain, so that the bit to flip is found quickly.  Flipping a bit changes
+   only the gains for bits that share a check with it, so each flip takes
+   time proportional to the number of these bits, times the log of the 
+   number of bits, for updating the heap.
 
-   Returns the number of iterations done (as an "unsigned" for consistency
-   with enum_decode).  Regardless of whether or not a valid codeword was 
-   reached, the bit vector from thresholding the bit-by-bit probabilities is 
-   stored in dblk, and the resulting parity checks are stored in pchk (all 
-   will be zero if the codeword is valid).  The final probabilities for each 
-   bit being a 1 are stored in bprb.
+   The number of flips done is returned as the number of iterations.  The 
+   decoding and parity checks are stored as for prprp_decode.  The 
+   probabilities stored in bprb are just the bits of the decoding.
 
-   The setup procedure immediately below outputs headers for the detailed trace
-   file, if required.
+   The setup procedure immediately below finds the Tanner graph, and 
+   allocates space, using the procedure after it, which is also used for
+   Cascade.
 */
 
-void prprp_decode_setup (void)
+#define Wbf_limit 1000.0	/* Limit on magnitude of log ratios */
+
+void wbf_decode_setup
+( ldpc_decoder *d	/* Decoder to set up */
+)
 {
-  if (table==2)
-  { printf(
-     "  block  iter  changed  perrs    loglik   Eperrs   Eloglik  entropy\n");
-  }
+  graph_setup(d);
+  wbf_space(d);
 }
 
-unsigned prprp_decode
-( mod2sparse *H,	/* Parity check matrix */
+static void wbf_space
+( ldpc_decoder *d	/* Decoder, with its Tanner graph */
+)
+{
+  tanner_graph *G;
+
+  G = d->graph;
+
+  d->wbf_syn  = chk_alloc (tanner_rows(G), sizeof *d->wbf_syn);
+  d->wbf_mag  = chk_alloc (tanner_cols(G), sizeof *d->wbf_mag);
+  d->wbf_gain = chk_alloc (tanner_cols(G), sizeof *d->wbf_gain);
+  d->wbf_heap = chk_alloc (tanner_cols(G), sizeof *d->wbf_heap);
+  d->wbf_hpos = chk_alloc (tanner_cols(G), sizeof *d->wbf_hpos);
+}
+
+
+/* DO WEIGHTED BIT FLIPPING FOR A BLOCK.  Does at most max flips, leaving 
+   the parity checks in wbf_syn and wbf_unsat, and returns the number of 
+   flips done. */
+
+static int wbf_run
+( ldpc_decoder *d,	/* Decoder, with space allocated */
   double *lratio,	/* Likelihood ratios for bits */
   char *dblk,		/* Place to store decoding */
-  char *pchk,		/* Place to store parity checks */
-  double *bprb		/* Place to store bit probabilities */
+  int max		/* Maximum number of flips */
 )
-{ 
-  int N, n, c;
+{
+  tanner_graph *G;
+  double *mag, *gain;
+  char *syn;
+  double m, w, delta;
+  int M, N, n, i, j, k, e, p, q;
 
-  N = mod2sparse_cols(H);
+  G = d->graph;
+  M = tanner_rows(G);
+  N = tanner_cols(G);
 
-  /* Initialize probability and likelihood ratios, and find initial guess. */
+  syn = d->wbf_syn;
+  w = d->wbf_weight;
+  mag = d->wbf_mag;
+  gain = d->wbf_gain;
 
-  initprp(H,lratio,dblk,bprb);
+  /* Start with the hard decisions, and find the checks, and the gains from
+     flipping each bit. */
 
-  /* Do up to abs(max_iter) iterations of probability propagation, stopping
-     early if a codeword is found, unless max_iter is negative. */
+  for (j = 0; j<N; j++)
+  { m = fabs(log(lratio[j]));
+    mag[j] = m>Wbf_limit ? Wbf_limit : m;
+    dblk[j] = lratio[j]>1;
+    gain[j] = -mag[j];
+  }
 
-  for (n = 0; ; n++)
-  { 
-    c = check(H,dblk,pchk);
+  d->wbf_unsat = 0;
 
-    if (table==2)
-    { printf("%7d %5d %8.1f %6d %+9.2f %8.1f %+9.2f  %7.1f\n",
-       block_no, n, changed(lratio,dblk,N), c, loglikelihood(lratio,dblk,N), 
-       expected_parity_errors(H,bprb), expected_loglikelihood(lratio,bprb,N),
-       entropy(bprb,N));
+  for (i = 0; i<M; i++)
+  { syn[i] = 0;
+    for (e = G->row_start[i]; e<G->row_start[i+1]; e++)
+    { syn[i] ^= dblk[G->edge_col[e]];
     }
-   
-    if (n==max_iter || n==-max_iter || (max_iter>0 && c==0))
-    { break; 
+    d->wbf_unsat += syn[i];
+    for (e = G->row_start[i]; e<G->row_start[i+1]; e++)
+    { gain[G->edge_col[e]] += syn[i] ? w : -w;
     }
-
-    iterprp(H,lratio,dblk,bprb);
   }
 
-  return n;
-}
-
+  for (p = 0; p<N; p++)
+  { d->wbf_heap[p] = p;
+    d->wbf_hpos[p] = p;
+  }
+  for (p = N/2-1; p>=0; p--)
+  { heap_down(d->wbf_heap,d->wbf_hpos,gain,N,p);
+  }
 
-/* INITIALIZE PROBABILITY PROPAGATION.  Stores initial ratios, probabilities,
-   and guess at decoding. */
+  /* Flip bits until a codeword is found or no flip helps.  Flipping bit j
+     negates its gain, and flipping check i changes the gain for its other
+     bits by twice the weight. */
 
-void initprp
-( mod2sparse *H,	/* Parity check matrix */
-  double *lratio,	/* Likelihood ratios for bits */
-  char *dblk,		/* Place to store decoding */
-  double *bprb		/* Place to store bit probabilities, 0 if not wanted */
-)
-{ 
-  mod2entry *e;
-  int N;
-  int j;
+  for (n = 0; n<max && d->wbf_unsat>0; n++)
+  { 
+    j = d->wbf_heap[0];
+    if (gain[j]<=0) break;
 
-  N = mod2sparse_cols(H);
+    dblk[j] ^= 1;
+    gain[j] = -gain[j];
+    heap_down(d->wbf_heap,d->wbf_hpos,gain,N,0);
 
-  for (j = 0; j<N; j++)
-  { for (e = mod2sparse_first_in_col(H,j);
-         !mod2sparse_at_end(e);
-         e = mod2sparse_next_in_col(e))
-    { e->pr = lratio[j];
-      e->lr = 1;
+    for (k = G->col_start[j]; k<G->col_start[j+1]; k++)
+    { i = G->edge_row[G->col_edge[k]];
+      syn[i] ^= 1;
+      d->wbf_unsat += syn[i] ? 1 : -1;
+      delta = syn[i] ? 2*w : -2*w;
+      for (e = G->row_start[i]; e<G->row_start[i+1]; e++)
+      { q = G->edge_col[e];
+        if (q==j) continue;
+        gain[q] += delta;
+        if (delta>0) 
+        { heap_up(d->wbf_heap,d->wbf_hpos,gain,d->wbf_hpos[q]);
+        }
+        else 
+        { heap_down(d->wbf_heap,d->wbf_hpos,gain,N,d->wbf_hpos[q]);
+        }
+      }
     }
-    if (bprb) bprb[j] = 1 - 1/(1+lratio[j]);
-    dblk[j] = lratio[j]>=1;
   }
+
+  return n;
 }
 
 
-/* DO ONE ITERATION OF PROBABILITY PROPAGATION. */
+/* DECODE A BLOCK BY WEIGHTED BIT FLIPPING. */
 
-void iterprp
-( mod2sparse *H,	/* Parity check matrix */
+unsigned wbf_decode
+( ldpc_decoder *d,	/* Decoder to use */
   double *lratio,	/* Likelihood ratios for bits */
   char *dblk,		/* Place to store decoding */
-  double *bprb		/* Place to store bit probabilities, 0 if not wanted */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb		/* Place to store bit probabilities */
 )
 {
-  double pr, dl, t;
-  mod2entry *e;
-  int N, M;
-  int i, j;
+  int n, j;
 
-  M = mod2sparse_rows(H);
-  N = mod2sparse_cols(H);
+  n = wbf_run(d,lratio,dblk,d->max_iter);
 
-  /* Recompute likelihood ratios. */
+  memcpy (pchk, d->wbf_syn, tanner_rows(d->graph));
 
-  for (i = 0; i<M; i++)
-  { dl = 1;
-    for (e = mod2sparse_first_in_row(H,i);
-         !mod2sparse_at_end(e);
-         e = mod2sparse_next_in_row(e))
-    { e->lr = dl;
-      dl *= 2/(1+e->pr) - 1;
-    }
-    dl = 1;
-    for (e = mod2sparse_last_in_row(H,i);
-         !mod2sparse_at_end(e);
-         e = mod2sparse_prev_in_row(e))
-    { t = e->lr * dl;
-      e->lr = (1-t)/(1+t);
-      dl *= 2/(1+e->pr) - 1;
+  if (bprb)
+  { for (j = 0; j<tanner_cols(d->graph); j++)
+    { bprb[j] = dblk[j];
     }
   }
 
-  /* Recompute probability ratios.  Also find the next guess based on the
-     individually most likely values. */
-
-  for (j = 0; j<N; j++)
-  { pr = lratio[j];
-    for (e = mod2sparse_first_in_col(H,j);
-         !mod2sparse_at_end(e);
-         e = mod2sparse_next_in_col(e))
-    { e->pr = pr;
-      pr *= e->lr;
-    }
-    if (isnan(pr))
-    { pr = 1;
-    }
-    if (bprb) bprb[j] = 1 - 1/(1+pr);
-    dblk[j] = pr>=1;
-    pr = 1;
-    for (e = mod2sparse_last_in_col(H,j);
-         !mod2sparse_at_end(e);
-         e = mod2sparse_prev_in_col(e))
-    { e->pr *= pr;
-      if (isnan(e->pr)) 
-      { e->pr = 1;
-      }
-      pr *= e->lr;
-    }
-  }
+  return n;
 }
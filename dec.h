@@ -14,30 +14,267 @@
  */
 
 
-/* DECODING METHOD, ITS PARAMETERS, AND OTHER VARIABLES.  The global variables 
-   declared here are located in dec.c. */
+/* DECODING METHODS. */
 
 typedef enum 
-{ Enum_block, Enum_bit, Prprp
+{ Enum_block, Enum_bit, Prprp, Minsum, Fixed, Trellis_block, Trellis_bit,
+  Dual_bit, Cascade, Gallager_b, Wbf, Prprp_llr
 } decoding_method;
 
-extern decoding_method dec_method; /* Decoding method to use */
+typedef enum 
+{ Flooding, Layered, Residual
+} prprp_schedule;
+
+#define Batch_vec 8	/* Batches are made up of groups of this many lanes */
+#define Batch_max 64	/* Maximum number of lanes in a batch */
+#define Kern_max 32	/* Largest degree of rows or columns done together */
+
+
+/* DECODER CONTEXT.  Holds the decoding method and its parameters, the trace
+   options, and the space used while decoding.  A decoder is created for a
+   code by dec_new, after which the method and parameters are set by 
+   storing into the fields in the first part of the structure, and then 
+   dec_setup is called.  Blocks can then be decoded by dec_decode (or by
+   dec_decode_batch, if batch_lanes is non-zero).
+
+   The code is not changed by decoding, so any number of decoders may be
+   used for the same code at once (eg, in different threads), provided they
+   are set up one at a time, since the first setup for a code builds its 
+   Tanner graph.  The generator matrix for the code must have been read 
+   (fully) for the Enum_block and Enum_bit methods. */
+
+typedef struct
+{
+  /* The code, method, parameters, and options, set before setup. */
+
+  ldpc_code *code;		/* Code being decoded */
+
+  decoding_method method;	/* Decoding method to use */
+  int max_iter;			/* Maximum number of iterations of decoding */
+
+  prprp_schedule schedule;	/* Order of updates for Prprp */
+  int layer_size;		/* Number of consecutive rows in a layer, if 
+				   non-zero */
+  char *layer_file;		/* File giving layer of each row, if 
+				   layer_size is 0 */
+
+  int stop_after;		/* Number of iterations with an unchanging (or 
+				   alternating) guess after which Prprp gives 
+				   up, 0 if it never does */
+
+  int osd;			/* Do ordered-statistics decoding for blocks 
+				   where Prprp doesn't find a codeword? */
+  int osd_order;		/* Most information bits flipped by OSD */
+
+  int batch_lanes;		/* Number of blocks decoded at once, 0 if not 
+				   batched */
+
+  int enum_gray;		/* Enumerate messages in Gray code order, for
+				   Enum_block and Enum_bit? */
+  int enum_threads;		/* Number of threads to use for Enum_block,
+				   Enum_bit, and Dual_bit, 0 or 1 for no extra
+				   threads */
+
+  double ms_scale;		/* Scale factor for check messages in Minsum */
+  double ms_offset;		/* Offset subtracted from check messages */
+
+  int fx_bits;			/* Number of bits in messages for Fixed */
+  double fx_step;		/* Log ratio represented by one unit, for Fixed */
+
+  int casc_iter;		/* Iterations of min-sum tried first, for 
+				   Cascade, which then does Prprp */
+  int casc_wbf;			/* Use Wbf rather than min-sum for the first
+				   stage of Cascade? */
+
+  double wbf_weight;		/* Weight of each check, for Wbf */
+
+  int table;			/* Trace option, 2 for a table of details */
+  int block_no;			/* Number of current block, from zero, for the
+				   trace, set by the caller */
+  double dl_end;		/* Time (as from dec_clock) after which no more
+				   iterations are started for the current 
+				   block, 0 if none, set by the caller */
+
+  /* Space used for decoding, allocated by setup.  Messages are stored in
+     arrays indexed by edge number in the code's Tanner graph. */
+
+  tanner_graph *graph;		/* Tanner graph for the code */
+  uint64_t *chk_words;		/* Space for the decoding packed for checking */
+
+  uint64_t *enum_basis;		/* Packed codewords for each message bit, if
+				   enum_gray is set or decoding is batched */
+  uint64_t *enum_book;		/* Packed codewords for all messages, if 
+				   decoding by enumeration is batched */
+  double *enum_dll;		/* Log likelihood for bit being 1 minus log
+				   likelihood for it being 0, by bit and lane */
+
+  uint64_t *dual_rows;		/* Packed rows of H, for Dual_bit */
+
+  unsigned *tr_col;		/* Columns of H as bit masks, for Trellis */
+  double *tr_alpha;		/* Forward probabilities, by bit and state */
+  double *tr_beta;		/* Backward probabilities, for two bits */
+  double *tr_metric;		/* Viterbi path log likelihoods, for two bits */
+  char *tr_choice;		/* Viterbi choices of bit, by bit and state */
+
+  double *edge_pr;		/* Probability ratios, for each edge */
+  double *edge_lr;		/* Likelihood ratios, for each edge */
 
-extern int table;	/* Trace option, 2 for a table of decoding details */
-extern int block_no;	/* Number of current block, from zero */
+  int *kern_rows;		/* Rows in order of degree, for Flooding */
+  int *kern_cols;		/* Columns in order of degree, for Flooding */
 
-extern int max_iter;	/* Maximum number of iteratons of decoding to do */
-extern char *gen_file;	/* Generator file for Enum_block and Enum_bit */
+  double *prp_post;		/* Probability ratios from all checks, for bits */
+  int n_layers;			/* Number of layers, for Layered schedule */
+  int *layer_start;		/* Start of each layer in layer_row, plus end */
+  int *layer_row;		/* Rows in each layer, in increasing order */
+  char *layer_disjoint;		/* Whether rows in each layer share no bits */
+  char *bit_mark;		/* Marks bits already seen in a layer */
+  double *res_in;		/* Messages from bits, by edge, as 2/(1+pr)-1, 
+				   for the Residual schedule */
+  double *res_new;		/* New messages from checks not yet sent, by 
+				   edge, as 2/(1+lr)-1 */
+  double *res_sent;		/* Messages last sent by checks, in that form */
+  double *res_key;		/* Bound on change from sending new messages, 
+				   by check */
+  char *res_exact;		/* Whether res_key is exact and res_new is
+				   current, by check */
+  int *res_heap;		/* Checks in a heap, by res_key */
+  int *res_hpos;		/* Position of each check in the heap */
+  char *prp_syn;		/* Parity checks for the current guess, by row */
+  int prp_unsat;		/* Number of parity checks not satisfied */
+  uint64_t prp_hash;		/* Hash of the current guess, for stop_after */
+  uint64_t stop_hash[2];	/* Hashes of the guesses one and two 
+				   iterations before, for stop_after */
+
+  mod2dense *osd_H;		/* Dense form of H, for OSD */
+  mod2dense *osd_DH;		/* H with columns in order of reliability */
+  mod2dense *osd_A, *osd_A2;	/* Space used in finding the inverse */
+  mod2dense *osd_AI;		/* Inverse of the parity part of H */
+  mod2dense *osd_B;		/* Columns of H for the information bits */
+  mod2dense *osd_G;		/* Parity bits for each information bit */
+  int osd_rank;			/* Rank of H (number of parity bits) */
+  int *osd_rows, *osd_rows_inv;	/* Rows used in the inverse, and the reverse */
+  int *osd_cols;		/* Parity then information columns, reordered */
+  int *osd_perm;		/* Bits in order of increasing reliability */
+  int *osd_info;		/* Information bits, as indexes in the block */
+  uint64_t *osd_gcol;		/* Packed parity bits for each information bit */
+  uint64_t *osd_par;		/* Packed parity bits, for each depth of search */
+  uint64_t *osd_ypar;		/* Packed hard decisions for the parity bits */
+  double *osd_pcost;		/* Cost of changing each parity bit */
+  double *osd_icost;		/* Change in cost from flipping each info bit */
+  int *osd_flip;		/* Information bits flipped at each depth */
+  int *osd_best;		/* Information bits flipped for best so far */
+  int osd_nbest;		/* Number of bits flipped for best so far */
+  double osd_best_cost;		/* Cost of best so far */
+
+  double *bat_bprb;		/* Bit probabilities, by bit and lane */
+
+  double *ms_c2v;		/* Check-to-bit messages (log ratios), by edge */
+  double *ms_ch;		/* Log ratios from received data, for each bit */
+  double *ms_tot;		/* Total log ratios, for each bit */
+  double *ms_new;		/* Space for new total log ratios, for each bit */
+  double *ms_v2c;		/* Messages from bits to the check being updated */
+  double *llr_tab;		/* Table of phi(x), for Prprp_llr */
+  double *llr_ph;		/* Phi of magnitudes of messages from bits */
+
+  signed char *fx_c2v8;		/* Check-to-bit messages, if fx_bits<=8 */
+  short *fx_c2v16;		/* Check-to-bit messages, if fx_bits>8 */
+  int fx_max;			/* Largest magnitude of a message */
+  int *fx_ch;			/* Quantized log ratios from received data */
+  char *fx_chd;			/* Decoding from unquantized data, for ties */
+  int *fx_tot;			/* Total log ratios, for each bit */
+  int *fx_new;			/* Space for new total log ratios, for each bit */
+  int *fx_v2c;			/* Messages from bits to the check being updated */
+
+  int casc_stage;		/* Stage that decoded the last block, for 
+				   Cascade: 1 for min-sum, 2 for Prprp */
+  int stopped;			/* Did Prprp give up early on the last block, 
+				   because of stop_after? */
+  int late;			/* Did decoding of the last block stop because
+				   the time in dl_end was reached? */
+
+  uint64_t *gb_v2c;		/* Bit-to-check messages, in column order, one 
+				   lane per bit of the word */
+  uint64_t *gb_chk;		/* Parities of messages or bits, by check */
+  uint64_t *gb_y;		/* Bits received, by bit */
+  uint64_t *gb_x;		/* Current decoding, by bit */
+  uint64_t *gb_ge;		/* Lanes with at least k disagreeing checks */
+  uint64_t *gb_dis;		/* Lanes where each check disagrees, for a bit */
+  int *gb_row;			/* Row for each message, in column order */
+  int *gb_pos;			/* Place of message for each edge in row order */
+
+  char *wbf_syn;		/* Parity checks for the current decoding */
+  int wbf_unsat;		/* Number of parity checks not satisfied */
+  double *wbf_mag;		/* Magnitude of log ratio from data, by bit */
+  double *wbf_gain;		/* Gain from flipping each bit */
+  int *wbf_heap;		/* Bits in a heap, by gain */
+  int *wbf_hpos;		/* Position of each bit in the heap */
+
+} ldpc_decoder;
+
+
+/* PROCEDURES FOR DECODERS. */
+
+ldpc_decoder *dec_new (ldpc_code *, decoding_method);
+void dec_setup (ldpc_decoder *);
+unsigned dec_decode (ldpc_decoder *, double *, char *, char *, double *);
+void dec_decode_batch 
+  (ldpc_decoder *, int, double **, char **, char **, double **, unsigned *);
+void dec_free (ldpc_decoder *);
+double dec_clock (void);
 
 
 /* PROCEDURES RELATING TO DECODING METHODS. */
 
-void enum_decode_setup (void);
-unsigned enum_decode (double *, char *, double *, int);
+void enum_decode_setup (ldpc_decoder *);
+unsigned enum_decode (ldpc_decoder *, double *, char *, double *, int);
+
+void enum_batch_setup (ldpc_decoder *);
+void enum_decode_batch
+  (ldpc_decoder *, int, double **, char **, double **, unsigned *, int);
+
+void prprp_decode_setup (ldpc_decoder *);
+unsigned prprp_decode (ldpc_decoder *, double *, char *, char *, double *);
+
+void osd_setup (ldpc_decoder *);
+void osd_decode (ldpc_decoder *, double *, char *, double *);
+
+void initprp (ldpc_decoder *, double *, char *, double *);
+void iterprp (ldpc_decoder *, double *, char *, double *);
+void iterlayer (ldpc_decoder *, double *, char *, double *);
+void initres (ldpc_decoder *);
+void iterres (ldpc_decoder *, double *, char *, double *);
+
+void trellis_decode_setup (ldpc_decoder *);
+unsigned trellis_decode (ldpc_decoder *, double *, char *, double *, int);
+
+void dual_decode_setup (ldpc_decoder *);
+unsigned dual_decode (ldpc_decoder *, double *, char *, double *);
+
+void minsum_decode_setup (ldpc_decoder *);
+unsigned minsum_decode (ldpc_decoder *, double *, char *, char *, double *);
+
+void initms (ldpc_decoder *, double *, char *);
+void iterms (ldpc_decoder *, char *);
+void msbitpr (ldpc_decoder *, double *);
+
+void llr_decode_setup (ldpc_decoder *);
+void iterllr (ldpc_decoder *, char *);
+
+void cascade_decode_setup (ldpc_decoder *);
+unsigned cascade_decode (ldpc_decoder *, double *, char *, char *, double *);
+
+void gallager_decode_setup (ldpc_decoder *);
+unsigned gallager_decode (ldpc_decoder *, double *, char *, char *, double *);
+void gallager_decode_batch
+  (ldpc_decoder *, int, double **, char **, char **, double **, unsigned *);
+
+void wbf_decode_setup (ldpc_decoder *);
+unsigned wbf_decode (ldpc_decoder *, double *, char *, char *, double *);
 
-void prprp_decode_setup (void);
-unsigned prprp_decode 
-(mod2sparse *, double *, char *, char *, double *);
+void fixed_decode_setup (ldpc_decoder *);
+unsigned fixed_decode (ldpc_decoder *, double *, char *, char *, double *);
 
-void initprp (mod2sparse *, double *, char *, double *);
-void iterprp (mod2sparse *, double *, char *, double *);
+void initfx (ldpc_decoder *, double *, char *);
+void iterfx8 (ldpc_decoder *, char *);
+void iterfx16 (ldpc_decoder *, char *);
+void fxbitpr (ldpc_decoder *, double *);
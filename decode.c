@@ -17,6 +17,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include "rand.h"
 #include "alloc.h"
@@ -28,10 +31,71 @@
 #include "channel.h"
 #include "rcode.h"
 #include "check.h"
+#include "tanner.h"
 #include "dec.h"
 
 
+/* SPACE FOR A BATCH OF BLOCKS.  Holds the blocks read and decoded at one 
+   time, along with the worker process that is decoding them, if decoding
+   is being done by several processes. */
+
+typedef struct
+{ int nread;			/* Number of blocks in batch, 0 if none */
+  int first;			/* Number of first block in batch */
+  char **dblk, **pchk;		/* Decodings and parity checks */
+  double **lratio;		/* Likelihood ratios */
+  double **bitpr;		/* Bit probabilities */
+  unsigned *iters;		/* Unsigned because can be huge for enum */
+  char *stage;			/* Stage that decoded each block, for cascade */
+  char *stopped;		/* Whether decoding gave up early on each 
+				   block, for stop */
+  char *late;			/* Whether time ran out for each block, for -D */
+  pid_t pid;			/* Process id of worker, or 0 if none */
+  int to, from;			/* Pipes to and from worker */
+} batch_space;
+
+
 void usage(void);
+int read_block (FILE *, double *);
+void decode_batch (batch_space *);
+int output_batch (batch_space *, FILE *, FILE *);
+void start_worker (batch_space *, int);
+void worker_loop (batch_space *);
+void send_batch (batch_space *);
+void receive_batch (batch_space *);
+void pipe_write (int, void *, size_t);
+int pipe_read (int, void *, size_t);
+
+
+/* CODE, DECODER, AND CHANNEL. */
+
+static ldpc_code *code;		/* Code whose blocks are decoded */
+static ldpc_decoder *dec;	/* Decoder for the code */
+static channel_spec chan;	/* Channel the blocks were received through */
+
+static double *rcv_data;	/* Place to store data from the channel */
+static uint64_t *chk_words;	/* Space for checking decodings */
+
+
+/* TOTALS FOR THE SUMMARY. */
+
+static int nblocks;		/* Number of blocks decoded so far */
+static int tot_valid;		/* Number of valid decodings */
+static double tot_iter;		/* Double because can be huge for enum */
+static double tot_changed;	/* Double because can be fraction if lratio==1*/
+static int tot_stage[3];	/* Number decoded by each stage, for cascade */
+static int tot_stopped;		/* Number given up on early, for stop */
+static int tot_late;		/* Number for which time ran out, for -D */
+
+static int nbatch;		/* Number of blocks decoded at once */
+static int nworkers;		/* Number of worker processes, 0 if none */
+static int bp_wanted;		/* Are bit probabilities to be written? */
+
+static double dl_budget;	/* Time allowed per block in seconds, 0 if no
+				   limit */
+static int dl_window;		/* Number of blocks over which time is shared */
+static int dl_count;		/* Number of blocks decoded by this process */
+static double dl_spare;		/* Time unused by earlier blocks in window */
 
 
 /* MAIN PROGRAM. */
@@ -41,46 +105,70 @@ int main
   char **argv
 )
 {
-  char *pchk_file, *rfile, *dfile, *pfile;
+  char *pchk_file, *rfile, *dfile, *pfile, *gen_file;
   char **meth;
   FILE *rf, *df, *pf;
 
-  char *dblk, *pchk;
-  double *lratio;
-  double *bitpr;
+  batch_space *bs;		/* Space for batches, one per worker */
+  int nspace;			/* Number of batch spaces */
 
-  double *awn_data;		/* Places to store channel data */
-  int *bsc_data;
+  char junk, x;
+  int nread;
+  int w, k, b;
 
-  unsigned iters;		/* Unsigned because can be huge for enum */
-  double tot_iter;		/* Double because can be huge for enum */
-  double chngd, tot_changed;	/* Double because can be fraction if lratio==1*/
+  /* Create the code and decoder, to be filled in later. */
 
-  int tot_valid;
-  char junk;
-  int valid;
-
-  int i, j, k;
+  code = code_new();
+  dec = dec_new(code,Prprp);
 
   /* Look at initial flag arguments. */
 
-  table = 0;
   blockio_flush = 0;
+  nworkers = 0;
 
   while (argc>1)
   {
     if (strcmp(argv[1],"-t")==0)
-    { if (table!=0) usage();
-      table = 1;
+    { if (dec->table!=0) usage();
+      dec->table = 1;
     }
     else if (strcmp(argv[1],"-T")==0)
-    { if (table!=0) usage();
-      table = 2;
+    { if (dec->table!=0) usage();
+      dec->table = 2;
     }
     else if (strcmp(argv[1],"-f")==0)
     { if (blockio_flush!=0) usage();
       blockio_flush = 1;
     }
+    else if (strcmp(argv[1],"-b")==0)
+    { if (dec->batch_lanes!=0 || argc<3) usage();
+      if (sscanf(argv[2],"%d%c",&dec->batch_lanes,&junk)!=1 
+       || dec->batch_lanes<=0 || dec->batch_lanes%Batch_vec!=0 
+       || dec->batch_lanes>Batch_max) 
+      { usage();
+      }
+      argc -= 1;
+      argv += 1;
+    }
+    else if (strcmp(argv[1],"-D")==0)
+    { if (dl_budget!=0 || argc<3) usage();
+      dl_window = 1;
+      k = sscanf(argv[2],"%lf%c%d%c",&dl_budget,&x,&dl_window,&junk);
+      if ((k!=1 && (k!=3 || x!='x')) || dl_budget<=0 || dl_window<=0)
+      { usage();
+      }
+      dl_budget /= 1000;
+      argc -= 1;
+      argv += 1;
+    }
+    else if (strcmp(argv[1],"-j")==0)
+    { if (nworkers!=0 || argc<3) usage();
+      if (sscanf(argv[2],"%d%c",&nworkers,&junk)!=1 || nworkers<=0) 
+      { usage();
+      }
+      argc -= 1;
+      argv += 1;
+    }
     else 
     { break;
     }
@@ -99,10 +187,10 @@ int main
 
   if (argv[4]==0 || argv[5]==0) usage();
 
-  k = channel_parse(argv+4,argc-4);
+  k = channel_parse_spec(&chan,argv+4,argc-4);
   if (k<=0)
   { pfile = argv[4];
-    k = channel_parse(argv+5,argc-5);
+    k = channel_parse_spec(&chan,argv+5,argc-5);
     if (k<=0) usage();
     meth = argv+5+k;
   }
@@ -117,23 +205,236 @@ int main
   if (!meth[0]) usage();
 
   if (strcmp(meth[0],"prprp")==0)
-  { dec_method = Prprp;
-    if (!meth[1] || sscanf(meth[1],"%d%c",&max_iter,&junk)!=1 || meth[2]) 
+  { dec->method = Prprp;
+    dec->schedule = Flooding;
+    if (!meth[1] || sscanf(meth[1],"%d%c",&dec->max_iter,&junk)!=1) 
     { usage();
     }
+    meth += 2;
+    if (meth[0] && strcmp(meth[0],"layered")==0)
+    { dec->schedule = Layered;
+      dec->layer_size = 1;
+      meth += 1;
+      if (meth[0] && strcmp(meth[0],"osd")!=0 && strcmp(meth[0],"stop")!=0)
+      { if (sscanf(meth[0],"%d%c",&dec->layer_size,&junk)!=1)
+        { dec->layer_size = 0;
+          dec->layer_file = meth[0];
+        }
+        else if (dec->layer_size<=0)
+        { usage();
+        }
+        meth += 1;
+      }
+    }
+    else if (meth[0] && strcmp(meth[0],"residual")==0)
+    { dec->schedule = Residual;
+      meth += 1;
+    }
+    if (meth[0] && strcmp(meth[0],"stop")==0)
+    { if (!meth[1] || sscanf(meth[1],"%d%c",&dec->stop_after,&junk)!=1 
+       || dec->stop_after<=0)
+      { usage();
+      }
+      meth += 2;
+    }
+    if (meth[0] && strcmp(meth[0],"osd")==0)
+    { dec->osd = 1;
+      if (!meth[1] || sscanf(meth[1],"%d%c",&dec->osd_order,&junk)!=1 
+       || dec->osd_order<0 || meth[2]) 
+      { usage();
+      }
+    }
+    else if (meth[0]) 
+    { usage();
+    }
+  }
+  else if (strcmp(meth[0],"trellis-block")==0 
+        || strcmp(meth[0],"trellis-bit")==0)
+  { dec->method = strcmp(meth[0],"trellis-block")==0 ? Trellis_block 
+                                                      : Trellis_bit;
+    if (meth[1]) usage();
+  }
+  else if (strcmp(meth[0],"dual-bit")==0)
+  { dec->method = Dual_bit;
+    if (meth[1])
+    { if (sscanf(meth[1],"%d%c",&dec->enum_threads,&junk)!=1 
+       || dec->enum_threads<=0 || meth[2]) 
+      { usage();
+      }
+    }
   }
-  else if (strcmp(meth[0],"enum-block")==0)
-  { dec_method = Enum_block;
-    if (!(gen_file = meth[1]) || meth[2]) usage();
+  else if (strcmp(meth[0],"minsum")==0)
+  { dec->method = Minsum;
+    dec->ms_scale = 1;
+    dec->ms_offset = 0;
+    if (!meth[1] || sscanf(meth[1],"%d%c",&dec->max_iter,&junk)!=1 
+     || meth[2]) 
+    { usage();
+    }
   }
-  else if (strcmp(meth[0],"enum-bit")==0)
-  { dec_method = Enum_bit;
-    if (!(gen_file = meth[1]) || meth[2]) usage();
+  else if (strcmp(meth[0],"nms")==0)
+  { dec->method = Minsum;
+    dec->ms_offset = 0;
+    if (!meth[1] || sscanf(meth[1],"%lf%c",&dec->ms_scale,&junk)!=1 
+     || dec->ms_scale<=0 || dec->ms_scale>1
+     || !meth[2] || sscanf(meth[2],"%d%c",&dec->max_iter,&junk)!=1 
+     || meth[3]) 
+    { usage();
+    }
+  }
+  else if (strcmp(meth[0],"oms")==0)
+  { dec->method = Minsum;
+    dec->ms_scale = 1;
+    if (!meth[1] || sscanf(meth[1],"%lf%c",&dec->ms_offset,&junk)!=1 
+     || dec->ms_offset<0
+     || !meth[2] || sscanf(meth[2],"%d%c",&dec->max_iter,&junk)!=1 
+     || meth[3]) 
+    { usage();
+    }
+  }
+  else if (strcmp(meth[0],"prprp-llr")==0)
+  { dec->method = Prprp_llr;
+    if (!meth[1] || sscanf(meth[1],"%d%c",&dec->max_iter,&junk)!=1 
+     || meth[2]) 
+    { usage();
+    }
+  }
+  else if (strcmp(meth[0],"gallager-b")==0)
+  { dec->method = Gallager_b;
+    if (!meth[1] || sscanf(meth[1],"%d%c",&dec->max_iter,&junk)!=1 
+     || meth[2]) 
+    { usage();
+    }
+    if (chan.type!=BSC)
+    { fprintf(stderr,"The gallager-b method can only be used with a BSC\n");
+      exit(1);
+    }
+  }
+  else if (strcmp(meth[0],"wbf")==0)
+  { dec->method = Wbf;
+    if (!meth[1] || sscanf(meth[1],"%lf%c",&dec->wbf_weight,&junk)!=1 
+     || dec->wbf_weight<=0
+     || !meth[2] || sscanf(meth[2],"%d%c",&dec->max_iter,&junk)!=1 
+     || dec->max_iter<=0 || meth[3]) 
+    { usage();
+    }
+  }
+  else if (strcmp(meth[0],"cascade")==0)
+  { dec->method = Cascade;
+    dec->ms_offset = 0;
+    if (meth[1] && strcmp(meth[1],"wbf")==0)
+    { dec->casc_wbf = 1;
+      meth += 1;
+      if (!meth[1] || sscanf(meth[1],"%lf%c",&dec->wbf_weight,&junk)!=1 
+       || dec->wbf_weight<=0)
+      { usage();
+      }
+    }
+    else if (!meth[1] || sscanf(meth[1],"%lf%c",&dec->ms_scale,&junk)!=1 
+     || dec->ms_scale<=0 || dec->ms_scale>1)
+    { usage();
+    }
+    if (!meth[2] || sscanf(meth[2],"%d%c",&dec->casc_iter,&junk)!=1 
+     || dec->casc_iter<0
+     || !meth[3] || sscanf(meth[3],"%d%c",&dec->max_iter,&junk)!=1 
+     || meth[4]) 
+    { usage();
+    }
+  }
+  else if (strcmp(meth[0],"fixed")==0)
+  { dec->method = Fixed;
+    if (!meth[1] || sscanf(meth[1],"%d%c",&dec->fx_bits,&junk)!=1 
+     || dec->fx_bits<2 || dec->fx_bits>16
+     || !meth[2] || sscanf(meth[2],"%lf%c",&dec->fx_step,&junk)!=1 
+     || dec->fx_step<=0
+     || !meth[3] || sscanf(meth[3],"%d%c",&dec->max_iter,&junk)!=1 
+     || meth[4]) 
+    { usage();
+    }
+  }
+  else if (strcmp(meth[0],"enum-block")==0 || strcmp(meth[0],"enum-bit")==0)
+  { dec->method = strcmp(meth[0],"enum-block")==0 ? Enum_block : Enum_bit;
+    if (!(gen_file = meth[1])) usage();
+    meth += 2;
+    if (meth[0] && strcmp(meth[0],"gray")==0)
+    { dec->enum_gray = 1;
+      meth += 1;
+    }
+    if (meth[0])
+    { if (sscanf(meth[0],"%d%c",&dec->enum_threads,&junk)!=1 
+       || dec->enum_threads<=0 || meth[1]) 
+      { usage();
+      }
+    }
   }
   else 
   { usage();
   }
 
+  /* Check that batch decoding is possible for this method. */
+
+  if (dec->batch_lanes>0)
+  { if (dec->method!=Enum_block && dec->method!=Enum_bit
+     && dec->method!=Gallager_b)
+    { fprintf(stderr,
+"Decoding in batches (-b) is only possible with enum-block, enum-bit, or\n\
+gallager-b\n");
+      exit(1);
+    }
+    if (dec->enum_threads>1)
+    { fprintf(stderr,
+        "Can't decode with several threads when decoding in batches (-b)\n");
+      exit(1);
+    }
+    if (dec->table==2)
+    { fprintf(stderr,"Can't use -T when decoding in batches (-b)\n");
+      exit(1);
+    }
+    if (dl_budget>0)
+    { fprintf(stderr,"Can't use -D when decoding in batches (-b)\n");
+      exit(1);
+    }
+  }
+
+  /* Check that a time limit can be applied to this method. */
+
+  if (dl_budget>0 && dec->method!=Prprp && dec->method!=Minsum
+       && dec->method!=Prprp_llr && dec->method!=Cascade)
+  { fprintf(stderr,
+"Decoding with a time limit (-D) is only possible with prprp, minsum, nms,\n\
+oms, prprp-llr, or cascade\n");
+    exit(1);
+  }
+
+  /* Check that decoding with several processes is possible. */
+
+  if (nworkers>0 && dec->table==2)
+  { fprintf(stderr,"Can't use -T when decoding with several processes (-j)\n");
+    exit(1);
+  }
+
+  if (nworkers==1) 
+  { nworkers = 0;  /* no point in a single worker */
+  }
+
+  if (dec->enum_threads>1 && dec->table==2)
+  { fprintf(stderr,"Can't use -T when decoding with several threads\n");
+    exit(1);
+  }
+
+  if (dec->method==Cascade && dec->casc_wbf && dec->table==2)
+  { fprintf(stderr,"Can't use -T with cascade when the first stage is wbf\n");
+    exit(1);
+  }
+
+  if ((dec->method==Trellis_block || dec->method==Trellis_bit
+        || dec->method==Dual_bit || dec->method==Gallager_b 
+        || dec->method==Wbf) && dec->table==2)
+  { fprintf(stderr,
+      "Can't use -T with trellis, dual-bit, gallager-b, or wbf decoding\n");
+    exit(1);
+  }
+
   /* Check that we aren't overusing standard input or output. */
 
   if ((strcmp(pchk_file,"-")==0) 
@@ -141,23 +442,28 @@ int main
   { fprintf(stderr,"Can't read more than one stream from standard input\n");
     exit(1);
   }
-  if ((table>0) 
+  if ((dec->table>0) 
     + (strcmp(dfile,"-")==0) 
     + (pfile!=0 && strcmp(pfile,"-")==0) > 1)
   { fprintf(stderr,"Can't send more than one stream to standard output\n");
     exit(1);
   }
 
-  /* Read parity check file. */
+  /* Read parity check file, and generator file if needed. */
 
-  read_pchk(pchk_file);
+  code_read_pchk(code,pchk_file);
 
-  if (N<=M)
+  if (code->N<=code->M)
   { fprintf(stderr,
-     "Number of bits (%d) should be greater than number of checks (%d)\n",N,M);
+     "Number of bits (%d) should be greater than number of checks (%d)\n",
+     code->N,code->M);
     exit(1);
   }
 
+  if (dec->method==Enum_block || dec->method==Enum_bit)
+  { code_read_gen(code,gen_file,0);
+  }
+
   /* Open file of received data. */
 
   rf = open_file_std(rfile,"r");
@@ -176,6 +482,8 @@ int main
 
   /* Create file for bit probabilities, if specified. */
 
+  pf = NULL;
+
   if (pfile)
   { pf = open_file_std(pfile,"w");
     if (pf==NULL)
@@ -186,187 +494,523 @@ int main
 
   /* Allocate space for data from channel. */
 
-  switch (channel)
-  { case BSC:
-    { bsc_data = chk_alloc (N, sizeof *bsc_data);
-      break;
-    }
-    case AWGN: case AWLN:
-    { awn_data = chk_alloc (N, sizeof *awn_data);
-      break;
-    }
-    default:
-    { abort();
-    }
-  }
+  rcv_data = chk_alloc (code->N, sizeof *rcv_data);
+
+  /* Set up for checking decodings, using the packed form of the parity
+     checks, which the decoder will also use. */
+
+  code->packed = packed_checks_new(code->H);
+  chk_words = chk_alloc (packed_words(code->N), sizeof *chk_words);
+
+  /* Allocate other space, for as many blocks as are decoded at once, with
+     one such batch for each worker process, if there are any. */
 
-  /* Allocate other space. */
+  bp_wanted = pfile!=0;
 
-  dblk   = chk_alloc (N, sizeof *dblk);
-  lratio = chk_alloc (N, sizeof *lratio);
-  pchk   = chk_alloc (M, sizeof *pchk);
-  bitpr  = chk_alloc (N, sizeof *bitpr);
+  nbatch = dec->batch_lanes>0 ? dec->batch_lanes : 1;
+  nspace = nworkers>0 ? nworkers : 1;
+
+  bs = chk_alloc (nspace, sizeof *bs);
+
+  for (w = 0; w<nspace; w++)
+  { bs[w].nread  = 0;
+    bs[w].pid    = 0;
+    bs[w].dblk   = chk_alloc (nbatch, sizeof *bs[w].dblk);
+    bs[w].lratio = chk_alloc (nbatch, sizeof *bs[w].lratio);
+    bs[w].pchk   = chk_alloc (nbatch, sizeof *bs[w].pchk);
+    bs[w].bitpr  = chk_alloc (nbatch, sizeof *bs[w].bitpr);
+    bs[w].iters  = chk_alloc (nbatch, sizeof *bs[w].iters);
+    bs[w].stage  = chk_alloc (nbatch, sizeof *bs[w].stage);
+    bs[w].stopped= chk_alloc (nbatch, sizeof *bs[w].stopped);
+    bs[w].late   = chk_alloc (nbatch, sizeof *bs[w].late);
+    for (b = 0; b<nbatch; b++)
+    { bs[w].dblk[b]   = chk_alloc (code->N, sizeof **bs[w].dblk);
+      bs[w].lratio[b] = chk_alloc (code->N, sizeof **bs[w].lratio);
+      bs[w].pchk[b]   = chk_alloc (code->M, sizeof **bs[w].pchk);
+      bs[w].bitpr[b]  = chk_alloc (code->N, sizeof **bs[w].bitpr);
+    }
+  }
 
   /* Print header for summary table. */
 
-  if (table==1)
-  { printf("  block iterations valid  changed\n");
+  if (dec->table==1)
+  { printf("  block iterations valid  changed%s%s%s\n",
+           dec->method==Cascade ? "  stage" : "",
+           dec->stop_after>0 ? "  stopped" : "",
+           dl_budget>0 ? "  late" : "");
   }
 
   /* Do the setup for the decoding method. */
 
-  switch (dec_method)
-  { case Prprp: 
-    { prprp_decode_setup();
-      break;
-    }
-    case Enum_block: case Enum_bit:
-    { enum_decode_setup();
-      break;
-    }
-    default: abort();
+  dec_setup(dec);
+
+  /* Start the worker processes, if there are to be any.  They are started
+     after the setup above, so that each has its own copy of everything 
+     needed for decoding. */
+
+  for (w = 0; w<nworkers; w++)
+  { start_worker(bs,w);
   }
 
-  /* Read received blocks, decode, and write decoded blocks. */
+  /* Read received blocks, decode, and write decoded blocks.  When decoding
+     in batches, up to batch_lanes blocks are read and decoded at once, 
+     then written out in order.  When there are worker processes, batches
+     are handed to them in turn, and the results for a batch are waited 
+     for (and written) just before that worker is given another batch, or 
+     at the end, so that output is in the same order as the input. */
 
   tot_iter = 0;
   tot_valid = 0;
   tot_changed = 0;
+  tot_stopped = 0;
+  tot_late = 0;
+
+  nblocks = 0;
+  k = 0;
 
-  for (block_no = 0; ; block_no++)
+  w = 0;
+
+  for (;;)
   { 
-    /* Read block from received file, exit if end-of-file encountered. */
-
-    for (i = 0; i<N; i++)
-    { int c;
-      switch (channel)
-      { case BSC:  
-        { c = fscanf(rf,"%1d",&bsc_data[i]); 
-          break;
-        }
-        case AWGN: case AWLN:
-        { c = fscanf(rf,"%lf",&awn_data[i]); 
-          break;
-        }
-        default: abort();
-      }
-      if (c==EOF) 
-      { if (i>0)
-        { fprintf(stderr,
-          "Warning: Short block (%d long) at end of received file ignored\n",i);
-        }
-        goto done;
-      }
-      if (c<1 || channel==BSC && bsc_data[i]!=0 && bsc_data[i]!=1)
-      { fprintf(stderr,"File of received data is garbled\n");
-        exit(1);
-      }
+    /* Write out the previous batch given to this worker, if there is one. */
+
+    if (bs[w].nread>0)
+    { receive_batch(&bs[w]);
+      if (!output_batch(&bs[w],df,pf)) goto done;
     }
 
-    /* Find likelihood ratio for each bit. */
+    /* Read blocks from received file, stop if end-of-file encountered. */
 
-    switch (channel)
-    { case BSC:
-      { for (i = 0; i<N; i++)
-        { lratio[i] = bsc_data[i]==1 ? (1-error_prob) / error_prob
-                                     : error_prob / (1-error_prob);
-        }
-        break;
-      }
-      case AWGN:
-      { for (i = 0; i<N; i++)
-        { lratio[i] = exp(2*awn_data[i]/(std_dev*std_dev));
-        }
-        break;
-      }
-      case AWLN:
-      { for (i = 0; i<N; i++)
-        { double e, d1, d0;
-          e = exp(-(awn_data[i]-1)/lwidth);
-          d1 = 1 / ((1+e)*(1+1/e));
-          e = exp(-(awn_data[i]+1)/lwidth);
-          d0 = 1 / ((1+e)*(1+1/e));
-          lratio[i] = d1/d0;
-        }
-        break;
-      }
-      default: abort();
+    for (nread = 0; nread<nbatch; nread++)
+    { if (!read_block(rf,bs[w].lratio[nread])) break;
     }
 
-    /* Try to decode using the specified method. */
+    if (nread==0) break;
 
-    switch (dec_method)
-    { case Prprp:
-      { iters = prprp_decode (H, lratio, dblk, pchk, bitpr);
-        break;
-      }
-      case Enum_block: case Enum_bit:
-      { iters = enum_decode (lratio, dblk, bitpr, dec_method==Enum_block);
-        break;
+    bs[w].nread = nread;
+    bs[w].first = k;
+    k += nread;
+
+    /* Decode the blocks, or have a worker decode them. */
+
+    if (nworkers>0)
+    { send_batch(&bs[w]);
+    }
+    else
+    { decode_batch(&bs[w]);
+      if (!output_batch(&bs[w],df,pf)) goto done;
+    }
+
+    if (nread<nbatch) break;
+
+    w = (w+1) % nspace;
+  }
+
+  /* Write out batches that workers are still decoding, in order. */
+
+  for (b = 1; b<=nspace; b++)
+  { w = (w+1) % nspace;
+    if (bs[w].nread>0)
+    { receive_batch(&bs[w]);
+      if (!output_batch(&bs[w],df,pf)) goto done;
+    }
+  }
+
+  /* Finish up. */
+
+done: 
+  fprintf(stderr,
+  "Decoded %d blocks, %d valid.  Average %.1f iterations, %.0f%% bit changes\n",
+   nblocks, tot_valid, (double)tot_iter/nblocks, 
+   100.0*(double)tot_changed/(code->N*nblocks));
+  if (dec->method==Cascade)
+  { fprintf(stderr,
+      "Stage 1 (%s) decoded %d blocks, %d went on to stage 2 (prprp)\n",
+      dec->casc_wbf ? "wbf" : "min-sum", tot_stage[1], tot_stage[2]);
+  }
+  if (dec->stop_after>0)
+  { fprintf(stderr,
+      "Gave up early on %d blocks, after no progress in decoding\n",
+      tot_stopped);
+  }
+  if (dl_budget>0)
+  { fprintf(stderr,
+      "Ran out of time for %d blocks, before decoding finished\n",
+      tot_late);
+  }
+
+  /* Tell the worker processes to stop, and wait for them to do so. */
+
+  for (w = 0; w<nworkers; w++)
+  { close(bs[w].to);
+    close(bs[w].from);
+  }
+
+  for (w = 0; w<nworkers; w++)
+  { waitpid(bs[w].pid,NULL,0);
+  }
+
+  if (ferror(df) || fclose(df)!=0)
+  { fprintf(stderr,"Error writing decoded blocks to %s\n",dfile);
+    exit(1);
+  }
+
+  if (pfile)
+  { if (ferror(pf) || fclose(pf)!=0)
+    { fprintf(stderr,"Error writing bit probabilities to %s\n",dfile);
+      exit(1);
+    }
+  }
+
+  exit(0);
+}
+
+
+/* DECODE A BATCH OF BLOCKS.  Uses the method specified, with the batch 
+   decoding procedure if batch_lanes is non-zero, and otherwise one block
+   at a time.  
+
+   When there is a time limit (-D), the blocks decoded by this process are 
+   divided into windows of dl_window blocks.  Each block is allowed its 
+   own time budget plus whatever time earlier blocks in the same window 
+   didn't use (or minus what they went over), after which the decoder 
+   starts no more iterations. */
+
+void decode_batch
+( batch_space *bs	/* Batch of blocks to decode */
+)
+{
+  double start;
+  int b;
+
+  if (dec->batch_lanes>0)
+  { dec->block_no = bs->first;
+    dec_decode_batch (dec, bs->nread, bs->lratio, bs->dblk, bs->pchk, 
+                      bs->bitpr, bs->iters);
+    return;
+  }
+
+  start = 0;
+
+  for (b = 0; b<bs->nread; b++)
+  { dec->block_no = bs->first + b;
+    if (dl_budget>0)
+    { if (dl_count%dl_window==0) 
+      { dl_spare = 0;
       }
-      default: abort();
+      start = dec_clock();
+      dec->dl_end = start + dl_budget + dl_spare;
     }
+    bs->iters[b] = dec_decode (dec, bs->lratio[b], bs->dblk[b], 
+                               bs->pchk[b], bs->bitpr[b]);
+    if (dl_budget>0)
+    { dl_spare += dl_budget - (dec_clock() - start);
+      dl_count += 1;
+    }
+    bs->stage[b] = dec->casc_stage;
+    bs->stopped[b] = dec->stopped;
+    bs->late[b] = dec->late;
+  }
+}
+
+
+/* WRITE OUT A DECODED BATCH OF BLOCKS.  Writes the decoded blocks, the
+   bit probabilities (if pf isn't null), and the summary table entries (if
+   asked for), and adds to the totals for the summary.  The batch is then
+   marked as empty.  Returns 0 if there was an error writing, 1 if not. */
+
+int output_batch
+( batch_space *bs,	/* Batch of decoded blocks */
+  FILE *df,		/* File for decoded blocks */
+  FILE *pf		/* File for bit probabilities, or null */
+)
+{
+  double chngd;
+  int valid;
+  int b, j;
+
+  for (b = 0; b<bs->nread; b++)
+  { 
+    dec->block_no = nblocks;
+    nblocks += 1;
 
     /* See if it worked, and how many bits were changed. */
 
-    valid = check(H,dblk,pchk)==0;
+    valid = check_packed(code->packed,bs->dblk[b],bs->pchk[b],chk_words)==0;
 
-    chngd = changed(lratio,dblk,N);
+    chngd = changed(bs->lratio[b],bs->dblk[b],code->N);
 
-    tot_iter += iters;
+    tot_iter += bs->iters[b];
     tot_valid += valid;
     tot_changed += chngd;
+    tot_stage[(int)bs->stage[b]] += 1;
+    tot_stopped += bs->stopped[b];
+    tot_late += bs->late[b];
 
     /* Print summary table entry. */
 
-    if (table==1)
-    { printf ("%7d %10f    %d  %8.1f\n",
-        block_no, (double)iters, valid, (double)chngd);
+    if (dec->table==1)
+    { printf ("%7d %10f    %d  %8.1f",
+        dec->block_no, (double)bs->iters[b], valid, (double)chngd);
         /* iters is printed as a double to avoid problems if it's >= 2^31 */
+      if (dec->method==Cascade)
+      { printf ("      %d", bs->stage[b]);
+      }
+      if (dec->stop_after>0)
+      { printf ("        %d", bs->stopped[b]);
+      }
+      if (dl_budget>0)
+      { printf ("     %d", bs->late[b]);
+      }
+      printf ("\n");
       fflush(stdout);
     }
 
     /* Write decoded block. */
 
-    blockio_write(df,dblk,N);
+    blockio_write(df,bs->dblk[b],code->N);
 
     /* Write bit probabilities, if asked to. */
 
-    if (pfile)
-    { for (j = 0; j<N; j++)
-      { fprintf(pf," %.5f",bitpr[j]);
+    if (pf)
+    { for (j = 0; j<code->N; j++)
+      { fprintf(pf," %.5f",bs->bitpr[b][j]);
       }
       fprintf(pf,"\n");
     }
 
     /* Check for errors when writing. */
 
-    if (ferror(df) || pfile && ferror(pf))
-    { break;
+    if (ferror(df) || pf && ferror(pf))
+    { return 0;
     }
   }
 
-  /* Finish up. */
+  bs->nread = 0;
 
-done: 
-  fprintf(stderr,
-  "Decoded %d blocks, %d valid.  Average %.1f iterations, %.0f%% bit changes\n",
-   block_no, tot_valid, (double)tot_iter/block_no, 
-   100.0*(double)tot_changed/(N*block_no));
+  return 1;
+}
 
-  if (ferror(df) || fclose(df)!=0)
-  { fprintf(stderr,"Error writing decoded blocks to %s\n",dfile);
+
+/* START A WORKER PROCESS.  The worker is a copy of this process, which 
+   decodes batches sent to it through a pipe, and sends back the results 
+   through another pipe.  Output buffers are flushed first, so that the
+   worker won't write anything pending a second time.  The new worker closes
+   the pipes to workers started earlier, which it has no use for. */
+
+void start_worker
+( batch_space *bs,	/* Batch spaces for all workers */
+  int w			/* Index of the batch space for this worker */
+)
+{
+  int to[2], from[2];
+  int i;
+
+  fflush(NULL);
+
+  if (pipe(to)!=0 || pipe(from)!=0)
+  { fprintf(stderr,"Can't create pipes for worker process\n");
     exit(1);
   }
 
-  if (pfile)
-  { if (ferror(pf) || fclose(pf)!=0)
-    { fprintf(stderr,"Error writing bit probabilities to %s\n",dfile);
+  bs[w].pid = fork();
+
+  if (bs[w].pid<0)
+  { fprintf(stderr,"Can't create worker process\n");
+    exit(1);
+  }
+
+  if (bs[w].pid==0)
+  { for (i = 0; i<w; i++)
+    { close(bs[i].to);
+      close(bs[i].from);
+    }
+    close(to[1]);
+    close(from[0]);
+    bs[w].to = from[1];
+    bs[w].from = to[0];
+    worker_loop(&bs[w]);
+    _exit(0);
+  }
+
+  close(to[0]);
+  close(from[1]);
+  bs[w].to = to[1];
+  bs[w].from = from[0];
+}
+
+
+/* LOOP DONE BY A WORKER PROCESS.  Decodes batches until the parent closes
+   the pipe to the worker. */
+
+void worker_loop
+( batch_space *bs	/* Batch space for the worker, connected to parent */
+)
+{
+  int b;
+
+  while (pipe_read(bs->from,&bs->nread,sizeof bs->nread))
+  { pipe_read(bs->from,&bs->first,sizeof bs->first);
+    for (b = 0; b<bs->nread; b++)
+    { pipe_read(bs->from,bs->lratio[b],code->N*sizeof **bs->lratio);
+    }
+    decode_batch(bs);
+    pipe_write(bs->to,bs->iters,bs->nread*sizeof *bs->iters);
+    pipe_write(bs->to,bs->stage,bs->nread*sizeof *bs->stage);
+    pipe_write(bs->to,bs->stopped,bs->nread*sizeof *bs->stopped);
+    pipe_write(bs->to,bs->late,bs->nread*sizeof *bs->late);
+    for (b = 0; b<bs->nread; b++)
+    { pipe_write(bs->to,bs->dblk[b],code->N*sizeof **bs->dblk);
+      if (bp_wanted) 
+      { pipe_write(bs->to,bs->bitpr[b],code->N*sizeof **bs->bitpr);
+      }
+    }
+  }
+}
+
+
+/* SEND A BATCH TO A WORKER PROCESS. */
+
+void send_batch
+( batch_space *bs	/* Batch of blocks read, connected to worker */
+)
+{
+  int b;
+
+  pipe_write(bs->to,&bs->nread,sizeof bs->nread);
+  pipe_write(bs->to,&bs->first,sizeof bs->first);
+  for (b = 0; b<bs->nread; b++)
+  { pipe_write(bs->to,bs->lratio[b],code->N*sizeof **bs->lratio);
+  }
+}
+
+
+/* RECEIVE THE DECODED BATCH FROM A WORKER PROCESS.  The parity checks are
+   not sent back, since they are recomputed when the batch is written. */
+
+void receive_batch
+( batch_space *bs	/* Batch that worker was sent */
+)
+{
+  int b;
+
+  if (!pipe_read(bs->from,bs->iters,bs->nread*sizeof *bs->iters))
+  { fprintf(stderr,"Worker process failed\n");
+    exit(1);
+  }
+  pipe_read(bs->from,bs->stage,bs->nread*sizeof *bs->stage);
+  pipe_read(bs->from,bs->stopped,bs->nread*sizeof *bs->stopped);
+  pipe_read(bs->from,bs->late,bs->nread*sizeof *bs->late);
+  for (b = 0; b<bs->nread; b++)
+  { pipe_read(bs->from,bs->dblk[b],code->N*sizeof **bs->dblk);
+    if (bp_wanted) 
+    { pipe_read(bs->from,bs->bitpr[b],code->N*sizeof **bs->bitpr);
+    }
+  }
+}
+
+
+/* WRITE DATA TO A PIPE.  Exits with an error message if the data can't all
+   be written. */
+
+void pipe_write
+( int fd,		/* Pipe to write to */
+  void *data,		/* Data to write */
+  size_t n		/* Number of bytes to write */
+)
+{
+  ssize_t c;
+
+  while (n>0)
+  { c = write(fd,data,n);
+    if (c<=0)
+    { fprintf(stderr,"Error writing to pipe for worker process\n");
       exit(1);
     }
+    data = (char *) data + c;
+    n -= c;
   }
+}
 
-  exit(0);
+
+/* READ DATA FROM A PIPE.  Returns 0 if the pipe was closed before any data
+   was read, and 1 if all the data was read.  Exits with an error message if
+   the pipe was closed part way through, or some other error occurs. */
+
+int pipe_read
+( int fd,		/* Pipe to read from */
+  void *data,		/* Place to store data read */
+  size_t n		/* Number of bytes to read */
+)
+{
+  size_t t;
+  ssize_t c;
+
+  t = 0;
+
+  while (t<n)
+  { c = read(fd,(char *)data+t,n-t);
+    if (c==0 && t==0) 
+    { return 0;
+    }
+    if (c<=0)
+    { fprintf(stderr,"Error reading from pipe for worker process\n");
+      exit(1);
+    }
+    t += c;
+  }
+
+  return 1;
+}
+
+
+/* READ A BLOCK AND FIND LIKELIHOOD RATIOS.  Reads a block of data from the
+   received file, and finds the likelihood ratio for each bit.  Returns 1
+   if a block was read, or 0 if end-of-file was encountered first (with a
+   warning if only part of a block was read). */
+
+int read_block
+( FILE *rf,		/* File of received data */
+  double *lratio	/* Place to store likelihood ratios */
+)
+{
+  int i;
+
+  /* Read block from received file, return if end-of-file encountered. */
+
+  for (i = 0; i<code->N; i++)
+  { int c, v;
+    switch (chan.type)
+    { case BSC:  
+      { c = fscanf(rf,"%1d",&v); 
+        if (c==1 && v!=0 && v!=1) c = 0;
+        rcv_data[i] = v;
+        break;
+      }
+      case AWGN: case AWLN:
+      { c = fscanf(rf,"%lf",&rcv_data[i]); 
+        break;
+      }
+      default: abort();
+    }
+    if (c==EOF) 
+    { if (i>0)
+      { fprintf(stderr,
+        "Warning: Short block (%d long) at end of received file ignored\n",i);
+      }
+      return 0;
+    }
+    if (c<1)
+    { fprintf(stderr,"File of received data is garbled\n");
+      exit(1);
+    }
+  }
+
+  /* Find likelihood ratio for each bit. */
+
+  channel_lratio(&chan,rcv_data,lratio,code->N);
+
+  return 1;
 }
 
 
@@ -376,9 +1020,33 @@ done:
 void usage(void)
 { fprintf(stderr,"Usage:\n");
   fprintf(stderr,
-"  decode [ -f ] [ -t | -T ] pchk-file received-file decoded-file [ bp-file ] channel method\n");
+"  decode [ -f ] [ -t | -T ] [ -b lanes ] [ -j processes ] [ -D ms[xblocks] ]\n");
+  fprintf(stderr,
+"         pchk-file received-file decoded-file\n");
+  fprintf(stderr,
+"         [ bp-file ] channel method\n");
   channel_usage();
   fprintf(stderr,
-"Method:  enum-block gen-file | enum-bit gen-file | prprp [-]max-iterations\n");
+"Method:  enum-block gen-file [ gray ] [ threads ]\n");
+  fprintf(stderr,
+"         enum-bit gen-file [ gray ] [ threads ]\n");
+  fprintf(stderr,
+"         trellis-block | trellis-bit | dual-bit [ threads ]\n");
+  fprintf(stderr,
+"         prprp [-]max-iterations [ layered [ layer-size | layer-file ]\n");
+  fprintf(stderr,
+"                                 | residual ] [ stop K ] [ osd order ]\n");
+  fprintf(stderr,
+"         prprp-llr [-]max-iterations\n");
+  fprintf(stderr,
+"         minsum [-]max-iterations | nms scale [-]max-iterations\n");
+  fprintf(stderr,
+"         oms offset [-]max-iterations\n");
+  fprintf(stderr,
+"         fixed bits step [-]max-iterations\n");
+  fprintf(stderr,
+"         cascade scale|wbf weight fast-iterations [-]max-iterations\n");
+  fprintf(stderr,
+"         gallager-b [-]max-iterations | wbf weight max-flips\n");
   exit(1);
 }
@@ -27,21 +27,90 @@
 
 
 /* The procedures in this module obtain the generator matrix to use for
-   encoding from the global variables declared in rcode.h */
+   encoding from the code context passed, which must have had its generator
+   matrix read (fully).  The code is not changed, so several blocks may be
+   encoded at once, provided each uses its own u and v. */
+
+
+/* ALLOCATE SPACE NEEDED FOR ENCODING.  Sets u and v to the dense matrices
+   needed by code_encode for this code, or to null if none are needed. */
+
+void encode_space
+( ldpc_code *code,	/* Code to be used for encoding */
+  mod2dense **u,	/* Set to first matrix needed */
+  mod2dense **v		/* Set to second matrix needed */
+)
+{
+  int M, N;
+
+  M = code->M;
+  N = code->N;
+
+  *u = *v = 0;
+
+  if (code->type=='d')
+  { *u = mod2dense_allocate(N-M,1);
+    *v = mod2dense_allocate(M,1);
+  }
+
+  if (code->type=='m')
+  { *u = mod2dense_allocate(M,1);
+    *v = mod2dense_allocate(M,1);
+  }
+}
+
+
+/* ENCODE A BLOCK.  Uses the procedure below appropriate to the type of 
+   representation of the generator matrix, with u and v as set up by 
+   encode_space. */
+
+void code_encode
+( ldpc_code *code,	/* Code to use */
+  char *sblk,		/* Source block */
+  char *cblk,		/* Place to store encoded block */
+  mod2dense *u,		/* Space for use in encoding */
+  mod2dense *v
+)
+{
+  switch (code->type)
+  { case 's':
+    { sparse_encode (code, sblk, cblk);
+      break;
+    }
+    case 'd':
+    { dense_encode (code, sblk, cblk, u, v);
+      break;
+    }
+    case 'm':
+    { mixed_encode (code, sblk, cblk, u, v);
+      break;
+    }
+    default: abort();
+  }
+}
 
 
 /* ENCODE A BLOCK USING A SPARSE REPRESENTATION OF THE GENERATOR MATRIX. */
 
 void sparse_encode
-( char *sblk,
+( ldpc_code *code,
+  char *sblk,
   char *cblk
 )
 {
+  mod2sparse *H;
+  int *cols;
+  int M, N;
   int i, j;
 
   mod2entry *e;
   char *x, *y;
 
+  H = code->H;
+  cols = code->cols;
+  M = code->M;
+  N = code->N;
+
   x = chk_alloc (M, sizeof *x);
   y = chk_alloc (M, sizeof *y);
 
@@ -66,8 +135,8 @@ void sparse_encode
   /* Solve Ly=x for y by forward substitution, then U(cblk)=y by backward
      substitution. */
 
-  if (!mod2sparse_forward_sub(L,rows,x,y)
-   || !mod2sparse_backward_sub(U,cols,y,cblk))
+  if (!mod2sparse_forward_sub(code->L,code->rows,x,y)
+   || !mod2sparse_backward_sub(code->U,cols,y,cblk))
   { 
     abort(); /* Shouldn't occur, even if the parity check matrix has 
                 redundant rows */
@@ -81,14 +150,21 @@ void sparse_encode
 /* ENCODE A BLOCK USING DENSE REPRESENTATION OF GENERATOR MATRIX. */
 
 void dense_encode
-( char *sblk,
+( ldpc_code *code,
+  char *sblk,
   char *cblk,
   mod2dense *u,
   mod2dense *v
 )
 {
+  int *cols;
+  int M, N;
   int j;
 
+  cols = code->cols;
+  M = code->M;
+  N = code->N;
+
   /* Copy source bits to the systematic part of the coded block. */
 
   for (j = M; j<N; j++) 
@@ -101,7 +177,7 @@ void dense_encode
   { mod2dense_set(u,j-M,0,sblk[j-M]); 
   }
   
-  mod2dense_multiply(G,u,v);
+  mod2dense_multiply(code->G,u,v);
 
   /* Copy check bits to the right places in the coded block. */
 
@@ -114,15 +190,24 @@ void dense_encode
 /* ENCODE A BLOCK USING MIXED REPRESENTATION OF GENERATOR MATRIX. */
 
 void mixed_encode
-( char *sblk,
+( ldpc_code *code,
+  char *sblk,
   char *cblk,
   mod2dense *u,
   mod2dense *v
 )
 {
+  mod2sparse *H;
   mod2entry *e;
+  int *cols;
+  int M, N;
   int j;
 
+  H = code->H;
+  cols = code->cols;
+  M = code->M;
+  N = code->N;
+
   /* Multiply the vector of source bits by the message bit columns of the 
      parity check matrix.  Also copy these bits to the coded block.  Take
      account of how columns have been reordered. */
@@ -144,7 +229,7 @@ void mixed_encode
 
   /* Multiply by Inv(A) to produce check bits. */
 
-  mod2dense_multiply(G,u,v);
+  mod2dense_multiply(code->G,u,v);
 
   /* Copy check bits to the right places in the coded block. */
 
@@ -13,6 +13,9 @@
  * risk.
  */
 
-void sparse_encode (char *, char *);
-void dense_encode  (char *, char *, mod2dense *, mod2dense *);
-void mixed_encode  (char *, char *, mod2dense *, mod2dense *);
+void encode_space  (ldpc_code *, mod2dense **, mod2dense **);
+void code_encode   (ldpc_code *, char *, char *, mod2dense *, mod2dense *);
+
+void sparse_encode (ldpc_code *, char *, char *);
+void dense_encode  (ldpc_code *, char *, char *, mod2dense *, mod2dense *);
+void mixed_encode  (ldpc_code *, char *, char *, mod2dense *, mod2dense *);
@@ -26,6 +26,7 @@
 #include "mod2dense.h"
 #include "mod2convert.h"
 #include "rcode.h"
+#include "check.h"
 #include "enc.h"
 
 void usage(void);
@@ -40,10 +41,13 @@ int main
 {
   char *source_file, *encoded_file;
   char *pchk_file, *gen_file;
+  ldpc_code *code;
   mod2dense *u, *v;
 
   FILE *srcf, *encf;
   char *sblk, *cblk, *chks;
+  uint64_t *cwords;
+  int M, N;
   int i, n;
 
   /* Look at initial flag arguments. */
@@ -83,7 +87,11 @@ int main
 
   /* Read parity check file */
 
-  read_pchk(pchk_file);
+  code = code_new();
+  code_read_pchk(code,pchk_file);
+
+  M = code->M;
+  N = code->N;
 
   if (N<=M)
   { fprintf(stderr,
@@ -94,19 +102,11 @@ int main
 
   /* Read generator matrix file. */
 
-  read_gen(gen_file,0,0);
+  code_read_gen(code,gen_file,0);
 
   /* Allocate needed space. */
 
-  if (type=='d')
-  { u = mod2dense_allocate(N-M,1);
-    v = mod2dense_allocate(M,1);
-  }
-
-  if (type=='m')
-  { u = mod2dense_allocate(M,1);
-    v = mod2dense_allocate(M,1);
-  }
+  encode_space(code,&u,&v);
 
   /* Open source file. */
 
@@ -127,6 +127,9 @@ int main
   sblk = chk_alloc (N-M, sizeof *sblk);
   cblk = chk_alloc (N, sizeof *cblk);
   chks = chk_alloc (M, sizeof *chks);
+  cwords = chk_alloc (packed_words(N), sizeof *cwords);
+
+  code->packed = packed_checks_new(code->H);
 
   /* Encode successive blocks. */
 
@@ -140,30 +143,14 @@ int main
 
     /* Compute encoded block. */
 
-    switch (type)
-    { case 's':
-      { sparse_encode (sblk, cblk);
-        break;
-      }
-      case 'd':
-      { dense_encode (sblk, cblk, u, v);
-        break;
-      }
-      case 'm':
-      { mixed_encode (sblk, cblk, u, v);
-        break;
-      }
-    }
+    code_encode (code, sblk, cblk, u, v);
 
     /* Check that encoded block is a code word. */
 
-    mod2sparse_mulvec (H, cblk, chks);
-
-    for (i = 0; i<M; i++) 
-    { if (chks[i]==1)
-      { fprintf(stderr,"Output block %d is not a code word!  (Fails check %d)\n",n,i);
-        abort(); 
-      }
+    if (check_packed (code->packed, cblk, chks, cwords)!=0)
+    { for (i = 0; chks[i]==0; i++) ;
+      fprintf(stderr,"Output block %d is not a code word!  (Fails check %d)\n",n,i);
+      abort(); 
     }
 
     /* Write encoded block to encoded output file. */
@@ -56,9 +56,6 @@ static mod2entry *alloc_entry
   e = m->next_free;
   m->next_free = e->left;
 
-  e->pr = 0;
-  e->lr = 0;
-
   return e;
 }
 
@@ -160,7 +157,7 @@ void mod2sparse_copy
   mod2sparse *r		/* Place to store copy of matrix */
 )
 {
-  mod2entry *e, *f;
+  mod2entry *e;
   int i;
 
   if (mod2sparse_rows(m)>mod2sparse_rows(r) 
@@ -176,9 +173,7 @@ void mod2sparse_copy
     e = mod2sparse_first_in_row(m,i); 
 
     while (!mod2sparse_at_end(e))
-    { f = mod2sparse_insert(r,e->row,e->col);
-      f->lr = e->lr;
-      f->pr = e->pr;
+    { mod2sparse_insert(r,e->row,e->col);
       e = mod2sparse_next_in_row(e);
     }
   }
@@ -45,9 +45,6 @@ typedef struct mod2entry /* Structure representing a non-zero entry, or
   struct mod2entry *left, *right,  /* Pointers to entries adjacent in row  */
                    *up, *down;     /*   and column, or to headers.  Free   */
                                    /*   entries are linked by 'left'.      */
-
-  double pr, lr;	  /* Probability and likelihood ratios - not used  */
-			  /*   by the mod2sparse module itself             */
 } mod2entry;
 
 #define Mod2sparse_block 10  /* Number of entries to block together for
@@ -45,12 +45,28 @@ mod2dense *G;		/* Dense or mixed representation of generator matrix,
 			   if type=='d' or type=='m' */
 
 
-/* READ PARITY CHECK MATRIX.  Sets the H, M, and N global variables.  If an
+/* CODE HOLDING DATA FOR THE GLOBAL VARIABLES.  The data read by read_pchk
+   and read_gen is read into this, and then copied to the global variables
+   above. */
+
+static ldpc_code global_code;
+
+
+/* CREATE A NEW CODE CONTEXT.  The code returned has nothing in it yet. */
+
+ldpc_code *code_new (void)
+{
+  return chk_alloc (1, sizeof (ldpc_code));
+}
+
+
+/* READ PARITY CHECK MATRIX.  Sets the H, M, and N fields of the code.  If an
    error is encountered, a message is displayed on standard error, and the
    program is terminated. */
 
-void read_pchk
-( char *pchk_file
+void code_read_pchk
+( ldpc_code *code,	/* Code to store matrix in */
+  char *pchk_file	/* Name of parity check file */
 )
 {
   FILE *f;
@@ -66,39 +82,39 @@ void read_pchk
     exit(1);
   }
 
-  H = mod2sparse_read(f);
+  code->H = mod2sparse_read(f);
 
-  if (H==0)
+  if (code->H==0)
   { fprintf(stderr,"Error reading parity check matrix from %s\n",pchk_file);
     exit(1);
   }
 
-  M = mod2sparse_rows(H);
-  N = mod2sparse_cols(H);
+  code->M = mod2sparse_rows(code->H);
+  code->N = mod2sparse_cols(code->H);
 
   fclose(f);
 }
 
 
-/* READ GENERATOR MATRIX.  The parity check matrix must have already been 
-   read, unless the last argument is set to 1.  The generator matrix must be 
-   compatible with the parity check matrix, if it has been read.  If the 
-   second argument is 1, only the column ordering (the last N-M of which are 
-   the indexes of the message bits) is read, into the 'cols' global variable.  
-   Otherwise, everything is read, into the global variables appropriate
-   to the representation.  The 'type' global variable is set to a letter
-   indicating which represention is used. 
+/* READ GENERATOR MATRIX.  If the parity check matrix for the code has been
+   read, the generator matrix must be compatible with it; if not, the M and
+   N fields are set from the generator matrix file.  If the last argument is
+   1, only the column ordering (the last N-M of which are the indexes of the
+   message bits) is read, into the 'cols' field.  Otherwise, everything is
+   read, into the fields appropriate to the representation.  The 'type' 
+   field is set to a letter indicating which represention is used. 
 
    If an error is encountered, a message is displayed on standard error,
    and the program is terminated. */
 
-void read_gen
-( char *gen_file,	/* Name of generator matrix file */
-  int cols_only,	/* Read only column ordering? */
-  int no_pchk_file	/* No parity check file used? */
+void code_read_gen
+( ldpc_code *code,	/* Code to store matrix in */
+  char *gen_file,	/* Name of generator matrix file */
+  int cols_only		/* Read only column ordering? */
 )
 {
-  int M2, N2;
+  int M, N, M2, N2;
+  char type;
   FILE *f;
   int i;
 
@@ -120,23 +136,27 @@ void read_gen
 
   if (feof(f) || ferror(f)) goto error;
 
-  if (no_pchk_file)
-  { M = M2;
-    N = N2;
+  if (code->H==0)
+  { code->M = M2;
+    code->N = N2;
   }
   else 
-  { if (M2!=M || N2!=N)
+  { if (M2!=code->M || N2!=code->N)
     { fprintf(stderr,
               "Generator matrix and parity-check matrix are incompatible\n");
       exit(1);
     }
   }
 
-  cols = chk_alloc (N, sizeof *cols);
-  rows = chk_alloc (M, sizeof *rows);
+  M = code->M;
+  N = code->N;
+
+  code->type = type;
+  code->cols = chk_alloc (N, sizeof *code->cols);
+  code->rows = chk_alloc (M, sizeof *code->rows);
 
   for (i = 0; i<N; i++)
-  { cols[i] = intio_read(f);
+  { code->cols[i] = intio_read(f);
     if (feof(f) || ferror(f)) goto error;
   }
 
@@ -147,33 +167,41 @@ void read_gen
       case 's':
       { 
         for (i = 0; i<M; i++)
-        { rows[i] = intio_read(f);
+        { code->rows[i] = intio_read(f);
           if (feof(f) || ferror(f)) goto error;
         }
 
-        if ((L = mod2sparse_read(f)) == 0) goto error;
-        if ((U = mod2sparse_read(f)) == 0) goto error;
+        if ((code->L = mod2sparse_read(f)) == 0) goto error;
+        if ((code->U = mod2sparse_read(f)) == 0) goto error;
   
-        if (mod2sparse_rows(L)!=M || mod2sparse_cols(L)!=M) goto garbled;
-        if (mod2sparse_rows(U)!=M || mod2sparse_cols(U)<M) goto garbled;
+        if (mod2sparse_rows(code->L)!=M || mod2sparse_cols(code->L)!=M) 
+        { goto garbled;
+        }
+        if (mod2sparse_rows(code->U)!=M || mod2sparse_cols(code->U)<M) 
+        { goto garbled;
+        }
        
         break;
       }
   
       case 'd':
       {
-        if ((G = mod2dense_read(f)) == 0) goto error;
+        if ((code->G = mod2dense_read(f)) == 0) goto error;
   
-        if (mod2dense_rows(G)!=M || mod2dense_cols(G)!=N-M) goto garbled;
+        if (mod2dense_rows(code->G)!=M || mod2dense_cols(code->G)!=N-M) 
+        { goto garbled;
+        }
   
         break;
       }
   
       case 'm':
       {
-        if ((G = mod2dense_read(f)) == 0) goto error;
+        if ((code->G = mod2dense_read(f)) == 0) goto error;
   
-        if (mod2dense_rows(G)!=M || mod2dense_cols(G)!=M) goto garbled;
+        if (mod2dense_rows(code->G)!=M || mod2dense_cols(code->G)!=M) 
+        { goto garbled;
+        }
   
         break;
       }
@@ -198,3 +226,50 @@ garbled:
   fprintf(stderr,"Garbled generator matrix in file %s\n",gen_file);
   exit(1);
 }
+
+
+/* READ PARITY CHECK MATRIX INTO GLOBAL VARIABLES.  Sets the H, M, and N 
+   global variables, using code_read_pchk. */
+
+void read_pchk
+( char *pchk_file
+)
+{
+  code_read_pchk(&global_code,pchk_file);
+
+  H = global_code.H;
+  M = global_code.M;
+  N = global_code.N;
+}
+
+
+/* READ GENERATOR MATRIX INTO GLOBAL VARIABLES.  The parity check matrix must
+   have already been read, unless the last argument is set to 1.  Otherwise
+   as for code_read_gen, but with the data read stored in the global 
+   variables.  Only the global variables for what was read are changed. */
+
+void read_gen
+( char *gen_file,	/* Name of generator matrix file */
+  int cols_only,	/* Read only column ordering? */
+  int no_pchk_file	/* No parity check file used? */
+)
+{
+  if (no_pchk_file)
+  { global_code.H = 0;
+  }
+
+  code_read_gen(&global_code,gen_file,cols_only);
+
+  M = global_code.M;
+  N = global_code.N;
+
+  type = global_code.type;
+  cols = global_code.cols;
+  rows = global_code.rows;
+
+  if (!cols_only)
+  { L = global_code.L;
+    U = global_code.U;
+    G = global_code.G;
+  }
+}
@@ -14,7 +14,40 @@
  */
 
 
-/* VARIABLES HOLDING DATA READ.  These are declared for real in rcode.c. */
+/* CODE CONTEXT.  Holds the parity check matrix for a code, and the 
+   generator matrix, if it has been read.  The fields are set by 
+   code_read_pchk and code_read_gen, and are not changed afterwards, so a
+   code may be shared by any number of encoders and decoders.  Several 
+   codes may be held at once. */
+
+typedef struct
+{ 
+  mod2sparse *H;	/* Parity check matrix, null if not read */
+
+  int M;		/* Number of rows in parity check matrix */
+  int N;		/* Number of columns in parity check matrix */
+
+  char type;		/* Type of generator matrix representation (s/d/m),
+			   or zero if no generator matrix has been read */
+  int *cols;		/* Ordering of columns in generator matrix */
+
+  mod2sparse *L, *U;	/* Sparse LU decomposition, if type=='s' */
+  int *rows;		/* Ordering of rows in generator matrix (type 's') */
+
+  mod2dense *G;		/* Dense or mixed representation of generator matrix,
+			   if type=='d' or type=='m' */
+
+  struct tanner_graph *graph; /* Tanner graph for H, built when first needed
+			   for decoding, null until then (see dec.c) */
+  struct packed_checks *packed; /* Parity checks in packed form, built when 
+			   first needed, null until then (see check.c) */
+
+} ldpc_code;
+
+
+/* VARIABLES HOLDING DATA READ.  These are declared for real in rcode.c, and
+   are set by read_pchk and read_gen, for use by programs that handle only
+   one code. */
 
 extern mod2sparse *H;	/* Parity check matrix */
 
@@ -33,5 +66,10 @@ extern mod2dense *G;	/* Dense or mixed representation of generator matrix,
 
 /* PROCEDURES FOR READING DATA. */
 
+ldpc_code *code_new (void);
+
+void code_read_pchk (ldpc_code *, char *);
+void code_read_gen  (ldpc_code *, char *, int);
+
 void read_pchk (char *);
 void read_gen  (char *, int, int);
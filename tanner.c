@@ -0,0 +1,119 @@
+/* TANNER.C - Procedures for compiled Tanner graphs used for decoding. */
+
+/* Copyright (c) 1995-2012 by Radford M. Neal.
+ *
+ * Permission is granted for anyone to copy, use, modify, and distribute
+ * these programs and accompanying documents for any purpose, provided
+ * this copyright notice is retained and prominently displayed, and note
+ * is made of any changes made to these programs.  These programs and
+ * documents are distributed without any warranty, express or implied.
+ * As the programs were written for research purposes only, they have not
+ * been tested to the degree that would be advisable in any important
+ * application.  All use of these programs is entirely at the user's own
+ * risk.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "mod2sparse.h"
+#include "tanner.h"
+
+
+/* BUILD A TANNER GRAPH FROM A PARITY CHECK MATRIX.  The matrix is only
+   read, and may be freed or changed afterwards without affecting the
+   graph. */
+
+tanner_graph *tanner_build
+( mod2sparse *H		/* Parity check matrix */
+)
+{
+  tanner_graph *g;
+  mod2entry *e;
+  int M, N, E;
+  int i, j, k;
+  int *fill;
+
+  M = mod2sparse_rows(H);
+  N = mod2sparse_cols(H);
+
+  g = chk_alloc (1, sizeof *g);
+
+  g->n_rows = M;
+  g->n_cols = N;
+
+  /* Count the edges in each row and each column. */
+
+  g->row_start = chk_alloc (M+1, sizeof *g->row_start);
+  g->col_start = chk_alloc (N+1, sizeof *g->col_start);
+
+  E = 0;
+  for (i = 0; i<M; i++)
+  { g->row_start[i] = E;
+    E += mod2sparse_count_row(H,i);
+  }
+  g->row_start[M] = E;
+
+  k = 0;
+  for (j = 0; j<N; j++)
+  { g->col_start[j] = k;
+    k += mod2sparse_count_col(H,j);
+  }
+  g->col_start[N] = k;
+
+  if (k!=E) abort();
+
+  g->n_edges = E;
+
+  /* Number the edges in row order, and record where each goes. */
+
+  g->edge_col = chk_alloc (E, sizeof *g->edge_col);
+  g->edge_row = chk_alloc (E, sizeof *g->edge_row);
+
+  for (i = 0; i<M; i++)
+  { k = g->row_start[i];
+    for (e = mod2sparse_first_in_row(H,i);
+         !mod2sparse_at_end(e);
+         e = mod2sparse_next_in_row(e))
+    { g->edge_col[k] = mod2sparse_col(e);
+      g->edge_row[k] = i;
+      k += 1;
+    }
+  }
+
+  /* Build the column-to-edge index.  Since edges are visited in row order,
+     the edges within each column end up in order of increasing row. */
+
+  g->col_edge = chk_alloc (E, sizeof *g->col_edge);
+  fill = chk_alloc (N, sizeof *fill);
+
+  for (j = 0; j<N; j++)
+  { fill[j] = g->col_start[j];
+  }
+
+  for (k = 0; k<E; k++)
+  { j = g->edge_col[k];
+    g->col_edge[fill[j]] = k;
+    fill[j] += 1;
+  }
+
+  free(fill);
+
+  return g;
+}
+
+
+/* FREE A TANNER GRAPH. */
+
+void tanner_free
+( tanner_graph *g	/* Graph to free */
+)
+{
+  free(g->row_start);
+  free(g->edge_col);
+  free(g->edge_row);
+  free(g->col_start);
+  free(g->col_edge);
+  free(g);
+}
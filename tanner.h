@@ -0,0 +1,59 @@
+/* TANNER.H - Interface to compiled Tanner graphs used for decoding. */
+
+/* Copyright (c) 1995-2012 by Radford M. Neal.
+ *
+ * Permission is granted for anyone to copy, use, modify, and distribute
+ * these programs and accompanying documents for any purpose, provided
+ * this copyright notice is retained and prominently displayed, and note
+ * is made of any changes made to these programs.  These programs and
+ * documents are distributed without any warranty, express or implied.
+ * As the programs were written for research purposes only, they have not
+ * been tested to the degree that would be advisable in any important
+ * application.  All use of these programs is entirely at the user's own
+ * risk.
+ */
+
+
+/* COMPILED TANNER GRAPH.  A read-only copy of the structure of a parity
+   check matrix, built once after the matrix has been read, in a form that
+   the decoding procedures can traverse without following pointers.
+
+   The edges of the graph (the 1s in the matrix) are numbered from zero in
+   row order, and within a row in order of increasing column index.  The
+   edges for row i are those numbered from row_start[i] to row_start[i+1]-1.
+   The edges for column j, in order of increasing row index, are the ones
+   whose numbers are stored in col_edge[col_start[j]] to
+   col_edge[col_start[j+1]-1].  Data that the decoder keeps for each edge
+   (such as the messages passed) is stored in arrays indexed by edge number,
+   and is therefore laid out contiguously by row. */
+
+typedef struct tanner_graph
+{
+  int n_rows;		/* Number of rows (checks) */
+  int n_cols;		/* Number of columns (bits) */
+  int n_edges;		/* Number of edges (1s in the matrix) */
+
+  int *row_start;	/* First edge of each row, plus n_edges at the end */
+  int *edge_col;	/* Column of each edge */
+  int *edge_row;	/* Row of each edge */
+
+  int *col_start;	/* Start of each column in col_edge, plus n_edges */
+  int *col_edge;	/* Edges in column order, as edge numbers */
+
+} tanner_graph;
+
+
+/* MACROS TO GET AT THE SIZE OF A TANNER GRAPH. */
+
+#define tanner_rows(g)  ((g)->n_rows)
+#define tanner_cols(g)  ((g)->n_cols)
+#define tanner_edges(g) ((g)->n_edges)
+
+#define tanner_row_degree(g,i) ((g)->row_start[(i)+1] - (g)->row_start[i])
+#define tanner_col_degree(g,j) ((g)->col_start[(j)+1] - (g)->col_start[j])
+
+
+/* PROCEDURES FOR TANNER GRAPHS. */
+
+tanner_graph *tanner_build (mod2sparse *);
+void tanner_free (tanner_graph *);
@@ -39,11 +39,14 @@ int main
 {
   char *coded_file, *source_file;
   char *pchk_file, *gen_file;
+  ldpc_code *code;
   int table;
 
   char *sblk, *cblk, *chks;
+  uint64_t *cwords;
   int seof, ceof;
   int srcerr, chkerr, bit_errs;
+  int M, N;
   int i, n;
   FILE *srcf, *codef;
 
@@ -88,7 +91,11 @@ int main
 
   /* Read parity check file. */
 
-  read_pchk(pchk_file);
+  code = code_new();
+  code_read_pchk(code,pchk_file);
+
+  M = code->M;
+  N = code->N;
 
   if (N<=M)
   { fprintf(stderr,
@@ -100,7 +107,7 @@ int main
      out which are the message bits. */
 
   if (gen_file!=0)
-  { read_gen(gen_file,1,0);
+  { code_read_gen(code,gen_file,1);
   }
 
   /* Open coded file to check. */
@@ -125,6 +132,9 @@ int main
   sblk = chk_alloc (N-M, sizeof *sblk);
   cblk = chk_alloc (N, sizeof *cblk);
   chks = chk_alloc (M, sizeof *chks);
+  cwords = chk_alloc (packed_words(N), sizeof *cwords);
+
+  code->packed = packed_checks_new(code->H);
 
   /* Print header for table. */
 
@@ -172,7 +182,7 @@ int main
     /* Check that received block is a code word, and if not find the number of
        parity check errors. */
 
-    chkerr = check(H,cblk,chks);
+    chkerr = check_packed(code->packed,cblk,chks,cwords);
 
     /* Check against source block, if provided, or against zeros, if
        the generator matrix was provided but no source file. */
@@ -181,14 +191,14 @@ int main
     { srcerr = 0;
       if (source_file!=0 && !seof)
       { for (i = M; i<N; i++)
-        { if (cblk[cols[i]]!=sblk[i-M])
+        { if (cblk[code->cols[i]]!=sblk[i-M])
           { srcerr += 1;
           }
         }
       }
       if (source_file==0)
       { for (i = M; i<N; i++)
-        { if (cblk[cols[i]]!=0)
+        { if (cblk[code->cols[i]]!=0)
           { srcerr += 1;
           }
         }